@@ -0,0 +1,521 @@
+/**
+ * Library Management System - Incremental Backup Implementation
+ *
+ * Key points:
+ *   - Full copies try FICLONE first, then copy_file_range, which
+ *     reflinks on btrfs/XFS and copies inside the kernel elsewhere;
+ *     plain reads and writes are the last resort
+ *   - A full point has one file per column (books.hot, books.cold); a
+ *     delta file is a range table followed by the records of those
+ *     ranges for each column, copied with the same in-kernel path
+ *   - The manifest is rewritten atomically after the backup file is
+ *     synced, so a crash never leaves a point that cannot be restored
+ *   - Only the newest BACKUP_RETAINED_FULLS chains are kept
+ */
+
+#include "backup.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace {
+    const char DIRTY_MAGIC[8] = { 'L', 'M', 'S', 'D', 'R', 'T', '0', '1' };
+    constexpr size_t COPY_BUFFER = 1 << 20;
+
+    struct DirtyHeader {
+        char magic[8];
+        uint64_t records;
+        uint64_t dataSize;
+        int64_t dataMtimeNs;
+        uint64_t dataTailChecksum;
+        uint64_t bitsChecksum;
+        uint64_t checksum;      // FNV-1a of every field above
+    };
+
+    struct DeltaRange {
+        uint64_t first;
+        uint64_t count;
+    };
+
+    uint64_t infoChecksum(const BackupInfo& info) {
+        return fnv1a(&info, offsetof(BackupInfo, checksum));
+    }
+
+    bool writeAll(int fd, const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t written = write(fd, bytes, length);
+            if (written <= 0) return false;
+            bytes += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void* data, size_t length, uint64_t offset) {
+        char* bytes = static_cast<char*>(data);
+        while (length > 0) {
+            ssize_t got = pread(fd, bytes, length, offset);
+            if (got <= 0) return false;
+            bytes += got;
+            length -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    int64_t nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Writes a backup file through a temporary name so partial copies never appear
+    template <typename Fill>
+    bool writeBackupFile(const string& path, Fill fill) {
+        string tempPath = path + ".tmp";
+        int fd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+
+        bool ok = fill(fd) && fsync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+            unlink(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+bool copyFileRange(int from, uint64_t fromOffset, int to, uint64_t toOffset, uint64_t length) {
+#ifdef __linux__
+    while (length > 0) {
+        loff_t in = fromOffset;
+        loff_t out = toOffset;
+        ssize_t copied = copy_file_range(from, &in, to, &out, length, 0);
+        if (copied <= 0) {
+            if (copied < 0 && (errno == EXDEV || errno == ENOSYS ||
+                               errno == EOPNOTSUPP || errno == EINVAL)) {
+                break;  // not supported here, finish with plain copies
+            }
+            return false;
+        }
+        fromOffset += copied;
+        toOffset += copied;
+        length -= copied;
+    }
+#endif
+
+    vector<char> buffer(min<uint64_t>(length, COPY_BUFFER));
+    while (length > 0) {
+        size_t chunk = min<uint64_t>(length, buffer.size());
+        if (!readAll(from, buffer.data(), chunk, fromOffset)) return false;
+        if (pwrite(to, buffer.data(), chunk, toOffset) != static_cast<ssize_t>(chunk)) return false;
+        fromOffset += chunk;
+        toOffset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool cloneFile(int from, int to, uint64_t length) {
+#ifdef FICLONE
+    // Shares every extent with the source: no data is written at all
+    if (ioctl(to, FICLONE, from) == 0) {
+        return ftruncate(to, length) == 0;
+    }
+#endif
+    return copyFileRange(from, 0, to, 0, length);
+}
+
+DirtyMap::DirtyMap() :
+    records(0),
+    unknown(true) {
+}
+
+void DirtyMap::resize(uint64_t recordCount) {
+    lock_guard<mutex> guard(lock);
+    bits.resize((recordCount + 63) / 64, 0);
+    if (recordCount % 64 != 0) {
+        bits.back() &= (uint64_t(1) << (recordCount % 64)) - 1;
+    }
+    records = recordCount;
+}
+
+void DirtyMap::mark(uint64_t slot) {
+    lock_guard<mutex> guard(lock);
+    if (slot < records) {
+        bits[slot / 64] |= uint64_t(1) << (slot % 64);
+    }
+}
+
+void DirtyMap::markRange(uint64_t first, uint64_t end) {
+    lock_guard<mutex> guard(lock);
+    end = min(end, records);
+    while (first < end && first % 64 != 0) {
+        bits[first / 64] |= uint64_t(1) << (first % 64);
+        first++;
+    }
+    for (; first + 64 <= end; first += 64) {
+        bits[first / 64] = ~uint64_t(0);
+    }
+    for (; first < end; first++) {
+        bits[first / 64] |= uint64_t(1) << (first % 64);
+    }
+}
+
+void DirtyMap::markUnknown() {
+    lock_guard<mutex> guard(lock);
+    unknown = true;
+}
+
+void DirtyMap::clear(uint64_t recordCount) {
+    lock_guard<mutex> guard(lock);
+    bits.assign((recordCount + 63) / 64, 0);
+    records = recordCount;
+    unknown = false;
+}
+
+bool DirtyMap::isUnknown() const {
+    lock_guard<mutex> guard(lock);
+    return unknown;
+}
+
+uint64_t DirtyMap::dirtyCount() const {
+    lock_guard<mutex> guard(lock);
+    uint64_t total = 0;
+    for (uint64_t word : bits) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+vector<pair<uint64_t, uint64_t>> DirtyMap::ranges() const {
+    lock_guard<mutex> guard(lock);
+    vector<pair<uint64_t, uint64_t>> result;
+    for (size_t w = 0; w < bits.size(); w++) {
+        uint64_t word = bits[w];
+        while (word != 0) {
+            uint64_t slot = w * 64 + __builtin_ctzll(word);
+            word &= word - 1;
+            if (!result.empty() && result.back().first + result.back().second == slot) {
+                result.back().second++;
+            } else {
+                result.emplace_back(slot, 1);
+            }
+        }
+    }
+    return result;
+}
+
+bool DirtyMap::save(const string& path, const DataFingerprint& data) const {
+    lock_guard<mutex> guard(lock);
+    if (unknown) {
+        unlink(path.c_str());
+        return true;
+    }
+
+    DirtyHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DIRTY_MAGIC, sizeof(DIRTY_MAGIC));
+    header.records = records;
+    header.dataSize = data.size;
+    header.dataMtimeNs = data.mtimeNs;
+    header.dataTailChecksum = data.tailChecksum;
+    header.bitsChecksum = fnv1a(bits.data(), bits.size() * sizeof(uint64_t));
+    header.checksum = fnv1a(&header, offsetof(DirtyHeader, checksum));
+
+    return writeBackupFile(path, [&](int fd) {
+        return writeAll(fd, &header, sizeof(header)) &&
+               writeAll(fd, bits.data(), bits.size() * sizeof(uint64_t));
+    });
+}
+
+bool DirtyMap::load(const string& path, const DataFingerprint& data) {
+    lock_guard<mutex> guard(lock);
+    unknown = true;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    DirtyHeader header;
+    vector<uint64_t> loaded;
+    bool valid = readAll(fd, &header, sizeof(header), 0) &&
+                 memcmp(header.magic, DIRTY_MAGIC, sizeof(DIRTY_MAGIC)) == 0 &&
+                 header.checksum == fnv1a(&header, offsetof(DirtyHeader, checksum)) &&
+                 header.dataSize == data.size &&
+                 header.dataMtimeNs == data.mtimeNs &&
+                 header.dataTailChecksum == data.tailChecksum;
+    if (valid) {
+        loaded.resize((header.records + 63) / 64);
+        valid = readAll(fd, loaded.data(), loaded.size() * sizeof(uint64_t), sizeof(header)) &&
+                header.bitsChecksum == fnv1a(loaded.data(), loaded.size() * sizeof(uint64_t));
+    }
+    close(fd);
+
+    if (!valid) return false;
+    bits = move(loaded);
+    records = header.records;
+    unknown = false;
+    return true;
+}
+
+BackupChain::BackupChain(const string& directory, const vector<BackupColumn>& columns) :
+    directory(directory),
+    columns(columns) {
+}
+
+string BackupChain::fullPath(uint32_t point, size_t column) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%06u.", point);
+    return directory + name + columns[column].name;
+}
+
+string BackupChain::deltaPath(uint32_t point) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%06u.delta", point);
+    return directory + name;
+}
+
+vector<string> BackupChain::pointFiles(const BackupInfo& info) const {
+    vector<string> paths;
+    if (info.full) {
+        for (size_t c = 0; c < columns.size(); c++) {
+            paths.push_back(fullPath(info.point, c));
+        }
+    } else {
+        paths.push_back(deltaPath(info.point));
+    }
+    return paths;
+}
+
+/**
+ * Reads the manifest. Chains whose full copy is missing a column
+ * (for example those taken before the table was split) cannot be
+ * restored, so they are dropped along with their files.
+ */
+bool BackupChain::open() {
+    points.clear();
+
+    int fd = ::open((directory + "/manifest").c_str(), O_RDONLY);
+    if (fd < 0) return errno == ENOENT;
+
+    BackupInfo info;
+    for (uint64_t offset = 0; readAll(fd, &info, sizeof(info), offset); offset += sizeof(info)) {
+        if (info.checksum != infoChecksum(info)) break;
+        points.push_back(info);
+    }
+    close(fd);
+
+    vector<BackupInfo> usable;
+    vector<string> orphaned;
+    bool chainUsable = false;
+    for (const BackupInfo& point : points) {
+        vector<string> files = pointFiles(point);
+        if (point.full) {
+            chainUsable = all_of(files.begin(), files.end(),
+                                 [](const string& path) { return access(path.c_str(), F_OK) == 0; });
+        }
+        if (chainUsable) {
+            usable.push_back(point);
+            continue;
+        }
+        orphaned.insert(orphaned.end(), files.begin(), files.end());
+        if (point.full) {
+            // Single-file full copy from before the split
+            char name[32];
+            snprintf(name, sizeof(name), "/%06u.full", point.point);
+            orphaned.push_back(directory + name);
+        }
+    }
+    if (usable.size() == points.size()) return true;
+
+    points = move(usable);
+    if (!saveManifest()) return false;
+    for (const string& path : orphaned) {
+        unlink(path.c_str());
+    }
+    return true;
+}
+
+bool BackupChain::saveManifest() const {
+    return writeBackupFile(directory + "/manifest", [&](int fd) {
+        return writeAll(fd, points.data(), points.size() * sizeof(BackupInfo));
+    });
+}
+
+// Drops the oldest chains, full copy and deltas together, and
+// returns their files for removal once the manifest is saved
+vector<string> BackupChain::prune() {
+    vector<string> expired;
+    size_t fulls = count_if(points.begin(), points.end(),
+                            [](const BackupInfo& info) { return info.full; });
+    while (fulls > BACKUP_RETAINED_FULLS) {
+        do {
+            vector<string> files = pointFiles(points.front());
+            expired.insert(expired.end(), files.begin(), files.end());
+            points.erase(points.begin());
+        } while (!points.front().full);
+        fulls--;
+    }
+    return expired;
+}
+
+bool BackupChain::createFull(const vector<int>& files, uint64_t recordCount, uint64_t changeSequence,
+                             BackupInfo& out) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+
+    BackupInfo info;
+    memset(&info, 0, sizeof(info));
+    info.point = points.empty() ? 1 : points.back().point + 1;
+    info.full = 1;
+    info.recordCount = recordCount;
+    info.recordsStored = recordCount;
+    info.timeNs = nowNs();
+    info.changeSequence = changeSequence;
+    info.checksum = infoChecksum(info);
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        if (!writeBackupFile(fullPath(info.point, c), [&](int fd) {
+                return cloneFile(files[c], fd, recordCount * columns[c].recordSize);
+            })) {
+            return false;
+        }
+    }
+
+    points.push_back(info);
+    vector<string> expired = prune();
+    if (!saveManifest()) return false;
+    for (const string& path : expired) {
+        unlink(path.c_str());
+    }
+    out = info;
+    return true;
+}
+
+/**
+ * Delta layout: range count, the (first, count) table, then for each
+ * column in turn the records of every range.
+ */
+bool BackupChain::createDelta(const vector<int>& files, uint64_t recordCount,
+                              const vector<pair<uint64_t, uint64_t>>& ranges,
+                              uint64_t changeSequence, BackupInfo& out) {
+    if (points.empty()) return false;
+
+    BackupInfo info;
+    memset(&info, 0, sizeof(info));
+    info.point = points.back().point + 1;
+    info.full = 0;
+    info.recordCount = recordCount;
+    info.timeNs = nowNs();
+    info.changeSequence = changeSequence;
+
+    vector<DeltaRange> table;
+    for (const auto& range : ranges) {
+        if (range.first >= recordCount) break;
+        uint64_t count = min(range.second, recordCount - range.first);
+        table.push_back({ range.first, count });
+        info.recordsStored += count;
+    }
+    info.checksum = infoChecksum(info);
+
+    if (!writeBackupFile(deltaPath(info.point), [&](int fd) {
+            uint64_t rangeCount = table.size();
+            if (!writeAll(fd, &rangeCount, sizeof(rangeCount)) ||
+                !writeAll(fd, table.data(), table.size() * sizeof(DeltaRange))) {
+                return false;
+            }
+            uint64_t offset = sizeof(rangeCount) + table.size() * sizeof(DeltaRange);
+            for (size_t c = 0; c < columns.size(); c++) {
+                size_t recordSize = columns[c].recordSize;
+                for (const DeltaRange& range : table) {
+                    uint64_t bytes = range.count * recordSize;
+                    if (!copyFileRange(files[c], range.first * recordSize, fd, offset, bytes)) {
+                        return false;
+                    }
+                    offset += bytes;
+                }
+            }
+            return true;
+        })) {
+        return false;
+    }
+
+    points.push_back(info);
+    out = info;
+    return saveManifest();
+}
+
+uint32_t BackupChain::deltasSinceFull() const {
+    uint32_t deltas = 0;
+    for (auto it = points.rbegin(); it != points.rend() && !it->full; ++it) {
+        deltas++;
+    }
+    return deltas;
+}
+
+const vector<BackupInfo>& BackupChain::list() const {
+    return points;
+}
+
+/**
+ * Rebuilds a point one column at a time: clone the full copy the
+ * chain starts from, then overwrite the ranges of each delta in order
+ * and cut the file to the record count of the delta.
+ */
+bool BackupChain::restore(uint32_t point, const vector<string>& targets) const {
+    auto last = find_if(points.begin(), points.end(),
+                        [&](const BackupInfo& info) { return info.point == point; });
+    if (last == points.end() || targets.size() != columns.size()) return false;
+    auto base = last;
+    while (!base->full) {
+        if (base == points.begin()) return false;
+        --base;
+    }
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        size_t recordSize = columns[c].recordSize;
+        bool restored = writeBackupFile(targets[c], [&](int fd) {
+            int full = ::open(fullPath(base->point, c).c_str(), O_RDONLY);
+            if (full < 0) return false;
+            bool ok = cloneFile(full, fd, base->recordCount * recordSize);
+            close(full);
+
+            for (auto it = base + 1; ok && it <= last; ++it) {
+                int delta = ::open(deltaPath(it->point).c_str(), O_RDONLY);
+                if (delta < 0) return false;
+
+                uint64_t rangeCount = 0;
+                ok = readAll(delta, &rangeCount, sizeof(rangeCount), 0);
+                vector<DeltaRange> table(ok ? rangeCount : 0);
+                ok = ok && readAll(delta, table.data(), table.size() * sizeof(DeltaRange), sizeof(rangeCount));
+
+                // Skip the sections of the columns stored before this one
+                uint64_t offset = sizeof(rangeCount) + table.size() * sizeof(DeltaRange);
+                for (size_t previous = 0; previous < c; previous++) {
+                    offset += it->recordsStored * columns[previous].recordSize;
+                }
+                for (size_t r = 0; ok && r < table.size(); r++) {
+                    uint64_t bytes = table[r].count * recordSize;
+                    ok = copyFileRange(delta, offset, fd, table[r].first * recordSize, bytes);
+                    offset += bytes;
+                }
+                ok = ok && ftruncate(fd, it->recordCount * recordSize) == 0;
+                close(delta);
+            }
+            return ok;
+        });
+        if (!restored) return false;
+    }
+    return true;
+}
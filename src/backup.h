@@ -0,0 +1,117 @@
+/**
+ * Library Management System - Incremental Backups
+ * Point-in-time copies of the book table kept as a chain in books.backups/
+ *
+ * The table is backed up column by column (one file per column, such
+ * as books.hot and books.cold), all indexed by the same slots.
+ * A chain starts with a full copy (000001.hot, 000001.cold), cloned
+ * with a reflink where the filesystem supports it, so it costs no data
+ * writes. Each later point is a delta holding only the record ranges
+ * written since the previous point. Restoring a point clones the full
+ * copy it builds on and replays the deltas in order.
+ *
+ * The engine marks written slots in a DirtyMap. The map is saved on
+ * shutdown with the data file fingerprint, so the next session can
+ * still take a delta; if the fingerprint no longer matches, the next
+ * backup is a full one.
+ */
+
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include "index.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+constexpr uint32_t BACKUP_DELTAS_PER_FULL = 24;  // a day of hourly backups
+constexpr size_t BACKUP_RETAINED_FULLS = 3;       // chains kept on disk
+
+// One manifest entry per backup point
+struct BackupInfo {
+    uint32_t point;
+    uint32_t full;              // 1 for a full copy, 0 for a delta
+    uint64_t recordCount;       // database size at this point
+    uint64_t recordsStored;     // records written into the backup file
+    int64_t timeNs;
+    uint64_t changeSequence;    // next change feed sequence at this point
+    uint64_t checksum;          // FNV-1a of every field above
+};
+
+// Slots written since the last backup; safe to mark from many threads
+class DirtyMap {
+private:
+    mutable mutex lock;
+    vector<uint64_t> bits;
+    uint64_t records;
+    bool unknown;           // lost track, the next backup must be full
+
+public:
+    DirtyMap();
+
+    void resize(uint64_t recordCount);
+    void mark(uint64_t slot);
+    void markRange(uint64_t first, uint64_t end);
+    void markUnknown();
+    void clear(uint64_t recordCount);
+
+    bool isUnknown() const;
+    uint64_t dirtyCount() const;
+    // Maximal runs of dirty slots as (first, count)
+    vector<pair<uint64_t, uint64_t>> ranges() const;
+
+    bool save(const string& path, const DataFingerprint& data) const;
+    // Leaves the map unknown when the file is missing or stale
+    bool load(const string& path, const DataFingerprint& data);
+};
+
+// A slot-indexed file of fixed-size records
+struct BackupColumn {
+    string name;
+    size_t recordSize;
+};
+
+class BackupChain {
+private:
+    string directory;
+    vector<BackupColumn> columns;
+    vector<BackupInfo> points;
+
+    string fullPath(uint32_t point, size_t column) const;
+    string deltaPath(uint32_t point) const;
+    vector<string> pointFiles(const BackupInfo& info) const;
+    bool saveManifest() const;
+    vector<string> prune();
+
+public:
+    BackupChain(const string& directory, const vector<BackupColumn>& columns);
+
+    // Reads the manifest; the directory is created by the first backup
+    bool open();
+
+    // files holds one descriptor per column, in column order
+    bool createFull(const vector<int>& files, uint64_t recordCount, uint64_t changeSequence,
+                    BackupInfo& out);
+    bool createDelta(const vector<int>& files, uint64_t recordCount,
+                     const vector<pair<uint64_t, uint64_t>>& ranges,
+                     uint64_t changeSequence, BackupInfo& out);
+
+    // Deltas written since the newest full copy
+    uint32_t deltasSinceFull() const;
+    const vector<BackupInfo>& list() const;
+
+    // Writes each column as of point to its target (each replaced atomically)
+    bool restore(uint32_t point, const vector<string>& targets) const;
+};
+
+// Copies length bytes between files, preferring reflinks and in-kernel copies
+bool copyFileRange(int from, uint64_t fromOffset, int to, uint64_t toOffset, uint64_t length);
+// Whole-file clone of from into the empty file to
+bool cloneFile(int from, int to, uint64_t length);
+
+#endif
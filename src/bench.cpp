@@ -0,0 +1,183 @@
+/**
+ * Library Management System - Circulation Contention Benchmark
+ *
+ * Usage: library-bench [books] [operations per thread]
+ *        library-bench batch [books] [records]
+ *
+ * Builds a scratch database (bench.hot/.cold next to the binary), then runs
+ * alternating checkout/return pairs from 1 to 16 threads, once
+ * spread over every book and once with all threads on a single book.
+ * Every operation is durable when it returns, so the numbers include
+ * the journal's group commit.
+ *
+ * The batch mode times the same records written one call at a time
+ * and as one batch: puts and updates of `records` books, and erases of
+ * a tenth as many, since every erase rewrites the table.
+ */
+
+#include "engine.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+    const char* BENCH_FILE = "bench.dat";
+
+    bool populate(LibraryEngine& engine, int books) {
+        vector<Book> records;
+        for (int id = 1; id <= books; id++) {
+            Book record = {};
+            record.id = id;
+            safeStrCopy(record.title, "Benchmark Title " + to_string(id));
+            safeStrCopy(record.author, "Benchmark Author");
+            record.price = 10.0f;
+            record.quantity = MAX_QUANTITY / 2;
+            records.push_back(record);
+        }
+        return engine.putBatch(records);
+    }
+
+    // Returns operations per second; hotBook = 0 spreads over all books
+    double run(LibraryEngine& engine, int threads, int operations, int books, int hotBook) {
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                mt19937 random(t + 1);
+                uniform_int_distribution<int> pick(1, books);
+                for (int i = 0; i < operations; i += 2) {
+                    int id = hotBook ? hotBook : pick(random);
+                    engine.checkout(id);
+                    engine.returnBook(id);
+                }
+            });
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        return threads * operations / elapsed.count();
+    }
+
+    double millisecondsSince(chrono::steady_clock::time_point start) {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    void printBatchRow(const char* operation, size_t count, double single, double batch) {
+        printf("%-9s %7zu %12.1f %10.1f %9.1fx\n", operation, count, single, batch,
+               batch > 0 ? single / batch : 0.0);
+    }
+
+    /**
+     * Writes ids books+1 .. books+records one call at a time and
+     * books+records+1 .. books+2*records as one batch, then updates
+     * and erases each half the same way. Returns false on the first
+     * engine error.
+     */
+    bool runBatches(LibraryEngine& engine, int books, int records) {
+        vector<Book> singles;
+        vector<Book> batched;
+        for (int i = 1; i <= records; i++) {
+            for (vector<Book>* half : { &singles, &batched }) {
+                Book record = {};
+                record.id = books + i + (half == &batched ? records : 0);
+                safeStrCopy(record.title, "Batch Title " + to_string(record.id));
+                safeStrCopy(record.author, "Batch Author");
+                record.price = 10.0f;
+                record.quantity = 1;
+                half->push_back(record);
+            }
+        }
+
+        cout << "Operation   Count    Single ms   Batch ms   Speed-up\n";
+
+        auto start = chrono::steady_clock::now();
+        for (const Book& record : singles) {
+            if (!engine.put(record)) return false;
+        }
+        double single = millisecondsSince(start);
+        start = chrono::steady_clock::now();
+        if (!engine.putBatch(batched)) return false;
+        printBatchRow("put", singles.size(), single, millisecondsSince(start));
+
+        BookPatch patch;
+        patch.quantity = 2;
+        vector<pair<int, BookPatch>> patches;
+        start = chrono::steady_clock::now();
+        for (const Book& record : singles) {
+            if (!engine.update(record.id, patch)) return false;
+        }
+        single = millisecondsSince(start);
+        for (const Book& record : batched) {
+            patches.emplace_back(record.id, patch);
+        }
+        start = chrono::steady_clock::now();
+        if (!engine.updateBatch(patches)) return false;
+        printBatchRow("update", singles.size(), single, millisecondsSince(start));
+
+        size_t erases = max<size_t>(1, singles.size() / 10);
+        vector<int> ids;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < erases; i++) {
+            if (!engine.erase(singles[i].id)) return false;
+        }
+        single = millisecondsSince(start);
+        for (size_t i = 0; i < erases; i++) {
+            ids.push_back(batched[i].id);
+        }
+        start = chrono::steady_clock::now();
+        if (!engine.eraseBatch(ids)) return false;
+        printBatchRow("erase", erases, single, millisecondsSince(start));
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool batchMode = argc > 1 && string(argv[1]) == "batch";
+    int first = batchMode ? 2 : 1;
+    int books = argc > first ? atoi(argv[first]) : (batchMode ? 20000 : 10000);
+    int operations = argc > first + 1 ? atoi(argv[first + 1]) : (batchMode ? 200 : 20000);
+    if (books <= 0 || operations <= 0) {
+        cerr << "Usage: " << argv[0] << " [books] [operations per thread]\n"
+             << "       " << argv[0] << " batch [books] [records]" << endl;
+        return 1;
+    }
+
+    int status = 0;
+    try {
+        LibraryEngine::removeFiles(BENCH_FILE);
+        LibraryEngine engine(BENCH_FILE);
+        if (!populate(engine, books)) {
+            cerr << "Unable to create benchmark data: " << engine.lastError() << endl;
+            return 1;
+        }
+
+        if (batchMode) {
+            cout << "Books: " << books << ", records per run: " << operations << "\n\n";
+            if (!runBatches(engine, books, operations)) {
+                cerr << "Batch benchmark failed: " << engine.lastError() << endl;
+                status = 1;
+            }
+        } else {
+            cout << "Books: " << books << ", operations per thread: " << operations << "\n\n";
+            cout << "Threads    Spread ops/s    Single-book ops/s\n";
+            for (int threads : { 1, 2, 4, 8, 16 }) {
+                double spread = run(engine, threads, operations, books, 0);
+                double single = run(engine, threads, operations, books, 1);
+                printf("%7d %15.0f %20.0f\n", threads, spread, single);
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return 1;
+    }
+
+    LibraryEngine::removeFiles(BENCH_FILE);
+    return status;
+}
@@ -0,0 +1,120 @@
+/**
+ * Library Management System - Record Formatting
+ *
+ * Key points:
+ *   - Rows and JSON are expanded from BOOK_SCHEMA, so a new field
+ *     shows up in the menu table and the change feed by itself
+ *   - Cells are appended to one preallocated string with snprintf,
+ *     not through iostream manipulators
+ *   - Text longer than its column ends in "..."; numbers use the
+ *     same output as the old setw/setprecision code
+ */
+
+#include "book.h"
+
+#include <cstdio>
+
+namespace {
+    void appendPadding(string& row, size_t used, int width) {
+        if (used < static_cast<size_t>(width)) {
+            row.append(width - used, ' ');
+        }
+    }
+
+    // Text cells are cut three characters short of the column
+    void appendText(string& row, const char* text, size_t maxLen, int width) {
+        size_t length = strnlen(text, maxLen);
+        size_t room = width > 3 ? width - 3 : 0;
+        if (length > room) {
+            size_t kept = room > 3 ? room - 3 : 0;
+            row.append(text, kept).append("...");
+            length = kept + 3;
+        } else {
+            row.append(text, length);
+        }
+        appendPadding(row, length, width);
+    }
+
+    template <FieldKind Kind, typename T>
+    void appendCell(string& row, const T& value, int width) {
+        char cell[32];
+        if constexpr (isTextKind(Kind)) {
+            appendText(row, value, sizeof(T) - 1, width);
+        } else if constexpr (Kind == FieldKind::Key) {
+            int length = snprintf(cell, sizeof(cell), "%04d", static_cast<int>(value));
+            row.append(cell, length);
+            appendPadding(row, length, width);
+        } else if constexpr (Kind == FieldKind::Real) {
+            row.append(cell, snprintf(cell, sizeof(cell), "%*.2f", width, static_cast<double>(value)));
+        } else {
+            row.append(cell, snprintf(cell, sizeof(cell), "%*d", width, static_cast<int>(value)));
+        }
+    }
+
+    void appendJsonString(ostream& out, const char* text, size_t maxLen) {
+        static const char* const hexDigits = "0123456789abcdef";
+        out << '"';
+        for (size_t i = 0; i < maxLen && text[i]; i++) {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (c < 0x20) {
+                out << "\\u00" << hexDigits[c >> 4] << hexDigits[c & 0xf];
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    template <FieldKind Kind, typename T>
+    void appendJsonValue(ostream& out, const T& value) {
+        if constexpr (isTextKind(Kind)) {
+            appendJsonString(out, value, sizeof(T));
+        } else if constexpr (Kind == FieldKind::Real) {
+            char number[32];
+            out.write(number, snprintf(number, sizeof(number), "%.2f", static_cast<double>(value)));
+        } else {
+            out << value;
+        }
+    }
+}
+
+string formatBookHeader() {
+    string header;
+    header.reserve(BOOK_ROW_WIDTH);
+    char cell[64];
+    for (const FieldInfo& field : BOOK_FIELDS) {
+        bool leftAligned = field.kind == FieldKind::Key || isTextKind(field.kind);
+        header.append(cell, snprintf(cell, sizeof(cell), leftAligned ? "%-*s" : "%*s",
+                                     field.width, field.label));
+    }
+    header.append(cell, snprintf(cell, sizeof(cell), "%*s", STATUS_WIDTH, "Status"));
+    return header;
+}
+
+#define BOOK_ROW_CELL(file, kind, name, label, size, width, ...) \
+    appendCell<FieldKind::kind>(row, book.name, width);
+
+string formatBookRow(const Book& book) {
+    string row;
+    row.reserve(BOOK_ROW_WIDTH);
+    BOOK_SCHEMA(BOOK_ROW_CELL)
+    size_t status = strnlen(book.status, MAX_STATUS_LENGTH - 1);
+    appendPadding(row, status, STATUS_WIDTH);
+    row.append(book.status, status);
+    return row;
+}
+
+#define BOOK_JSON_FIELD(file, kind, name, ...) \
+    out << "\"" #name "\":"; \
+    appendJsonValue<FieldKind::kind>(out, book.name); \
+    out << ',';
+
+void appendBookJson(ostream& out, const Book& book) {
+    out << '{';
+    BOOK_SCHEMA(BOOK_JSON_FIELD)
+    out << "\"status\":";
+    appendJsonString(out, book.status, MAX_STATUS_LENGTH);
+    out << '}';
+}
@@ -0,0 +1,222 @@
+/**
+ * Library Management System - Record Definition
+ * Shared by the storage engine and the menu interface
+ *
+ * BOOK_SCHEMA is the single description of a book record (schema.h
+ * explains the columns). The Book, HotRecord and ColdRecord layouts,
+ * the field table with offsets, the codecs between them, validation,
+ * the menu table row and the change feed JSON are all expanded from
+ * it. Adding a field, say an ISBN, is one line:
+ *   X(Cold, Text, isbn, "ISBN", 14, 15, 10, 13)
+ * A new field changes the layout of books.hot or books.cold and of
+ * change feed events, so existing files must be exported and
+ * re-imported; the engine refuses files stamped with another
+ * BOOK_LAYOUT.
+ */
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "schema.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <cstring>
+
+using namespace std;
+
+// Fields appended by a build, such as the schema test in CMakeLists.txt
+#ifndef BOOK_SCHEMA_EXTRA
+#define BOOK_SCHEMA_EXTRA(X)
+#endif
+
+//      file  kind  name      label     size width low   high
+#define BOOK_SCHEMA(X) \
+    X(Hot,  Key,  id,       "ID",      0,   6,  1,    2147483647) \
+    X(Cold, Text, title,    "Title",   50,  35, 3,    49)         \
+    X(Cold, Name, author,   "Author",  30,  20, 2,    29)         \
+    X(Hot,  Real, price,    "Price",   0,   10, 0.01, 9999.99)    \
+    X(Hot,  Int,  quantity, "Qty",     0,   10, 0,    999)        \
+    BOOK_SCHEMA_EXTRA(X)
+
+// Status is derived from quantity: text in Book, a flag in HotRecord
+constexpr int MAX_STATUS_LENGTH = 10;
+constexpr int STATUS_WIDTH = 12;
+constexpr uint32_t HOT_AVAILABLE = 1;   // status is "Available" rather than "Out"
+
+constexpr int RECORDS_PER_PAGE = 5;
+constexpr int FUZZY_RESULTS = 5;
+constexpr int LOW_STOCK_THRESHOLD = 3;
+constexpr size_t REPORT_ROWS = 20;
+
+#define BOOK_MEMBER(file, kind, name, label, size, ...) FieldType<FieldKind::kind, size>::type name;
+
+struct Book {
+    BOOK_SCHEMA(BOOK_MEMBER)
+    char status[MAX_STATUS_LENGTH];
+};
+
+/**
+ * On-disk split of a Book. Fields that change with every checkout live
+ * in a dense hot record (books.hot, 16 bytes today); the text that
+ * rarely changes lives in a cold record (books.cold) at the same slot.
+ */
+#define BOOK_HOT_MEMBER(file, kind, name, label, size, ...) BOOK_HOT_MEMBER_##file(kind, name, size)
+#define BOOK_HOT_MEMBER_Hot(kind, name, size) FieldType<FieldKind::kind, size>::type name;
+#define BOOK_HOT_MEMBER_Cold(kind, name, size)
+#define BOOK_COLD_MEMBER(file, kind, name, label, size, ...) BOOK_COLD_MEMBER_##file(kind, name, size)
+#define BOOK_COLD_MEMBER_Hot(kind, name, size)
+#define BOOK_COLD_MEMBER_Cold(kind, name, size) FieldType<FieldKind::kind, size>::type name;
+
+struct HotRecord {
+    BOOK_SCHEMA(BOOK_HOT_MEMBER)
+    uint32_t flags;
+};
+
+struct ColdRecord {
+    BOOK_SCHEMA(BOOK_COLD_MEMBER)
+};
+
+// Field table: BOOK_FIELDS[size_t(BookField::price)] describes price
+#define BOOK_FIELD_NAME(file, kind, name, ...) name,
+#define BOOK_FIELD_RECORD_Hot HotRecord
+#define BOOK_FIELD_RECORD_Cold ColdRecord
+#define BOOK_FIELD_INFO(file, kind, name, label, size, width, low, high) \
+    { #name, label, FieldKind::kind, FieldFile::file, sizeof(Book::name), offsetof(Book, name), \
+      offsetof(BOOK_FIELD_RECORD_##file, name), width, low, high },
+
+enum class BookField : size_t {
+    BOOK_SCHEMA(BOOK_FIELD_NAME)
+    Count
+};
+
+constexpr FieldInfo BOOK_FIELDS[] = {
+    BOOK_SCHEMA(BOOK_FIELD_INFO)
+};
+
+constexpr const FieldInfo& bookField(BookField field) {
+    return BOOK_FIELDS[static_cast<size_t>(field)];
+}
+
+// Limits used by the prompts, read from the schema
+constexpr int MAX_TITLE_LENGTH = sizeof(Book::title);
+constexpr int MAX_AUTHOR_LENGTH = sizeof(Book::author);
+constexpr float MIN_PRICE = static_cast<float>(bookField(BookField::price).low);
+constexpr float MAX_PRICE = static_cast<float>(bookField(BookField::price).high);
+constexpr int MIN_QUANTITY = static_cast<int>(bookField(BookField::quantity).low);
+constexpr int MAX_QUANTITY = static_cast<int>(bookField(BookField::quantity).high);
+
+#define BOOK_TEXT_FITS(file, kind, name, label, size, width, low, high) \
+    static_assert(!isTextKind(FieldKind::kind) || (high) < sizeof(Book::name), \
+                  #name ": the longest accepted text must leave room for its terminator");
+BOOK_SCHEMA(BOOK_TEXT_FITS)
+static_assert(sizeof(HotRecord) % sizeof(uint32_t) == 0, "hot records must stay word aligned");
+
+/**
+ * Fingerprint of the stored layouts: file, kind, name and size of
+ * every field plus the record sizes. Kept in books.layout and folded
+ * into the change feed magic, so files from another schema are refused
+ * instead of being misread.
+ */
+constexpr uint64_t layoutHash(const char* text, uint64_t hash) {
+    for (; *text; text++) {
+        hash = (hash ^ static_cast<unsigned char>(*text)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+#define BOOK_LAYOUT_TEXT(file, kind, name, label, size, ...) #file " " #kind " " #name " " #size ";"
+constexpr uint64_t BOOK_LAYOUT = layoutHash(BOOK_SCHEMA(BOOK_LAYOUT_TEXT),
+    14695981039346656037ULL ^ (sizeof(Book) << 32 | sizeof(HotRecord) << 16 | sizeof(ColdRecord)));
+
+// Copies src into a fixed field, truncating and always terminating
+inline void safeStrCopy(char* dest, const string& src, size_t maxLen) {
+    if (src.empty()) {
+        dest[0] = '\0';
+    } else {
+        strncpy(dest, src.c_str(), maxLen - 1);
+        dest[maxLen - 1] = '\0';
+    }
+}
+
+template <size_t N>
+void safeStrCopy(char (&dest)[N], const string& src) {
+    safeStrCopy(dest, src, N);
+}
+
+// Codecs: straight field copies, no branches beyond the status flag
+#define BOOK_TO_HOT(file, kind, name, ...) BOOK_TO_HOT_##file(name)
+#define BOOK_TO_HOT_Hot(name) memcpy(&hot.name, &book.name, sizeof(hot.name));
+#define BOOK_TO_HOT_Cold(name)
+#define BOOK_TO_COLD(file, kind, name, ...) BOOK_TO_COLD_##file(name)
+#define BOOK_TO_COLD_Hot(name)
+#define BOOK_TO_COLD_Cold(name) memcpy(&cold.name, &book.name, sizeof(cold.name));
+#define BOOK_FROM_PART(file, kind, name, ...) memcpy(&book.name, &BOOK_PART_##file.name, sizeof(book.name));
+#define BOOK_PART_Hot hot
+#define BOOK_PART_Cold cold
+
+inline HotRecord hotPart(const Book& book) {
+    HotRecord hot;
+    BOOK_SCHEMA(BOOK_TO_HOT)
+    hot.flags = strncmp(book.status, "Available", MAX_STATUS_LENGTH) == 0 ? HOT_AVAILABLE : 0;
+    return hot;
+}
+
+inline ColdRecord coldPart(const Book& book) {
+    ColdRecord cold;
+    BOOK_SCHEMA(BOOK_TO_COLD)
+    return cold;
+}
+
+inline Book joinParts(const HotRecord& hot, const ColdRecord& cold) {
+    Book book;
+    BOOK_SCHEMA(BOOK_FROM_PART)
+    safeStrCopy(book.status, (hot.flags & HOT_AVAILABLE) ? "Available" : "Out");
+    return book;
+}
+
+// Every field within its schema limits; all checks run, none short-circuit
+#define BOOK_VALID(file, kind, name, label, size, width, low, high) \
+    & validField<FieldKind::kind>(book.name, low, high)
+
+inline bool validBook(const Book& book) {
+    return true BOOK_SCHEMA(BOOK_VALID);
+}
+
+// Validates a value typed for one field, before it is stored
+inline bool validBookText(BookField field, const string& text) {
+    const FieldInfo& info = bookField(field);
+    return validText(info.kind, text.data(), text.size(), info.low, info.high);
+}
+
+template <typename T>
+bool validBookValue(BookField field, T value) {
+    const FieldInfo& info = bookField(field);
+    return (value >= static_cast<T>(info.low)) & (value <= static_cast<T>(info.high));
+}
+
+// Terminates every text field in place, for records from outside
+#define BOOK_TERMINATE(file, kind, name, ...) BOOK_TERMINATE_##kind(name)
+#define BOOK_TERMINATE_Key(name)
+#define BOOK_TERMINATE_Int(name)
+#define BOOK_TERMINATE_Real(name)
+#define BOOK_TERMINATE_Text(name) book.name[sizeof(book.name) - 1] = '\0';
+#define BOOK_TERMINATE_Name(name) BOOK_TERMINATE_Text(name)
+
+inline void terminateText(Book& book) {
+    BOOK_SCHEMA(BOOK_TERMINATE)
+    book.status[MAX_STATUS_LENGTH - 1] = '\0';
+}
+
+// Fixed-width menu table, one column per field plus status
+#define BOOK_COLUMN_WIDTH(file, kind, name, label, size, width, ...) + (width)
+constexpr size_t BOOK_ROW_WIDTH = 0 BOOK_SCHEMA(BOOK_COLUMN_WIDTH) + STATUS_WIDTH;
+
+string formatBookHeader();
+// Numbers wider than their column push the row out, as setw would
+string formatBookRow(const Book& book);
+// {"id":1,"title":"...",...,"status":"Available"}
+void appendBookJson(ostream& out, const Book& book);
+
+#endif
@@ -0,0 +1,486 @@
+/**
+ * Library Management System - Change Feed Implementation
+ *
+ * Key points:
+ *   - Appends go straight to the segment file; sync() makes them
+ *     durable and publish() moves the committed mark past them
+ *   - The mark is a 16-byte record in books.cdc.committed, written
+ *     with fdatasync for writes; checkouts, whose journal entry is
+ *     already durable, only pwrite it
+ *   - Readers never go past the mark, so they see each event once and
+ *     only after its change has committed
+ *   - Every event carries full before/after images, so the engine can
+ *     rebuild a lost checkout event exactly from its journal entry
+ */
+
+#include "changefeed.h"
+#include "index.h"
+#include "journal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Events carry the record layout, so a feed of another schema is
+    // refused rather than cut back as torn
+    constexpr uint32_t CHANGE_MAGIC = static_cast<uint32_t>(BOOK_LAYOUT ^ (BOOK_LAYOUT >> 32));
+    // Events written before the magic carried the layout ("CDC1") are
+    // read as long as the layout is still the one they were written with
+    constexpr uint32_t LEGACY_CHANGE_MAGIC = 0x31434443;
+    constexpr uint64_t LEGACY_CHANGE_LAYOUT = 0x79ed9b2243a5a93dULL;
+
+    bool knownMagic(uint32_t magic) {
+        return magic == CHANGE_MAGIC || (magic == LEGACY_CHANGE_MAGIC && BOOK_LAYOUT == LEGACY_CHANGE_LAYOUT);
+    }
+    constexpr size_t SEGMENT_DIGITS = 20;
+    constexpr int MARK_READ_ATTEMPTS = 3;
+
+    // Contents of books.cdc.committed
+    struct CommitMark {
+        uint64_t sequence;
+        uint64_t checksum;
+    };
+
+    string markPath(const string& base) {
+        return base + ".committed";
+    }
+
+    uint64_t markChecksum(uint64_t sequence) {
+        return fnv1a(&sequence, sizeof(sequence));
+    }
+
+    uint64_t eventChecksum(const ChangeEvent& event) {
+        return fnv1a(&event, offsetof(ChangeEvent, checksum));
+    }
+
+    bool validEvent(const ChangeEvent& event, uint64_t sequence) {
+        return knownMagic(event.magic) &&
+               event.sequence == sequence &&
+               event.checksum == eventChecksum(event);
+    }
+
+    string segmentPath(const string& base, uint64_t first) {
+        char suffix[SEGMENT_DIGITS + 2];
+        snprintf(suffix, sizeof(suffix), ".%020llu", static_cast<unsigned long long>(first));
+        return base + suffix;
+    }
+
+    // First sequence of every segment on disk, ascending
+    vector<uint64_t> listSegments(const string& base) {
+        size_t slash = base.find_last_of('/');
+        string directory = slash == string::npos ? "." : base.substr(0, slash + 1);
+        string prefix = (slash == string::npos ? base : base.substr(slash + 1)) + ".";
+
+        vector<uint64_t> found;
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) return found;
+
+        while (dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (name.size() != prefix.size() + SEGMENT_DIGITS ||
+                name.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+            string digits = name.substr(prefix.size());
+            if (all_of(digits.begin(), digits.end(), ::isdigit)) {
+                found.push_back(stoull(digits));
+            }
+        }
+        closedir(dir);
+
+        sort(found.begin(), found.end());
+        return found;
+    }
+
+    bool readEvent(int fd, uint64_t position, ChangeEvent& event) {
+        return pread(fd, &event, sizeof(event), position * sizeof(ChangeEvent)) ==
+               static_cast<ssize_t>(sizeof(event));
+    }
+
+    bool readMark(int fd, uint64_t& sequence) {
+        CommitMark mark;
+        if (pread(fd, &mark, sizeof(mark), 0) != static_cast<ssize_t>(sizeof(mark)) ||
+            mark.checksum != markChecksum(mark.sequence)) {
+            return false;
+        }
+        sequence = mark.sequence;
+        return true;
+    }
+
+    /**
+     * The committed mark as a reader sees it. A feed written before the
+     * mark existed has no file and is read in full; a read that races
+     * the writer's pwrite is retried, and shows nothing if it stays torn.
+     */
+    uint64_t readerMark(const string& base) {
+        int fd = open(markPath(base).c_str(), O_RDONLY);
+        if (fd < 0) return numeric_limits<uint64_t>::max();
+
+        uint64_t sequence = 0;
+        for (int attempt = 0; attempt < MARK_READ_ATTEMPTS && !readMark(fd, sequence); attempt++) {
+            sequence = 0;
+        }
+        close(fd);
+        return sequence;
+    }
+
+    ChangeEvent placeholder(uint64_t sequence) {
+        ChangeEvent event;
+        memset(&event, 0, sizeof(event));
+        event.magic = CHANGE_MAGIC;
+        event.type = static_cast<uint32_t>(ChangeType::Discarded);
+        event.sequence = sequence;
+        return event;
+    }
+}
+
+ChangeEvent makeChange(ChangeType type, const Book* before, const Book* after) {
+    ChangeEvent event;
+    memset(&event, 0, sizeof(event));
+    event.magic = CHANGE_MAGIC;
+    event.type = static_cast<uint32_t>(type);
+    event.timeNs = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    if (before) event.before = *before;
+    if (after) event.after = *after;
+    return event;
+}
+
+ChangeFeed::ChangeFeed(uint64_t segmentEvents, size_t retainedSegments) :
+    fd(-1),
+    markFd(-1),
+    nextSeq(1),
+    committed(1),
+    segmentEvents(max<uint64_t>(segmentEvents, 1)),
+    retainedSegments(max<size_t>(retainedSegments, 1)) {
+}
+
+ChangeFeed::~ChangeFeed() {
+    close();
+}
+
+bool ChangeFeed::open(const string& feedBase) {
+    lock_guard<mutex> guard(lock);
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    if (markFd >= 0) {
+        ::close(markFd);
+        markFd = -1;
+    }
+
+    base = feedBase;
+    segments = listSegments(base);
+    confirmed.clear();
+    if (!openSegment(segments.empty() ? 1 : segments.back())) return false;
+
+    markFd = ::open(markPath(base).c_str(), O_RDWR | O_CREAT, 0644);
+    if (markFd < 0) return false;
+
+    // Without a mark (a feed from before it existed) everything counts as published
+    if (!readMark(markFd, committed)) {
+        committed = nextSeq;
+        return saveMark(true);
+    }
+    committed = min(committed, nextSeq);
+    return true;
+}
+
+void ChangeFeed::close() {
+    lock_guard<mutex> guard(lock);
+    if (fd >= 0) {
+        syncFileData(fd);
+        ::close(fd);
+        fd = -1;
+    }
+    if (markFd >= 0) {
+        ::close(markFd);
+        markFd = -1;
+    }
+}
+
+bool ChangeFeed::saveMark(bool durable) {
+    CommitMark mark = { committed, markChecksum(committed) };
+    if (markFd < 0 || pwrite(markFd, &mark, sizeof(mark), 0) != static_cast<ssize_t>(sizeof(mark))) {
+        return false;
+    }
+    return !durable || syncFileData(markFd) == 0;
+}
+
+/**
+ * Opens (or creates) the segment starting at first as the append
+ * target. Only the last event needs checking on a clean shutdown; if it
+ * is torn or missing, the segment is scanned and cut after the last
+ * good event. A segment written under another record layout is left
+ * alone and refused.
+ */
+bool ChangeFeed::openSegment(uint64_t first) {
+    fd = ::open(segmentPath(base, first).c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    if (segments.empty() || segments.back() != first) {
+        segments.push_back(first);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) return false;
+
+    uint64_t count = info.st_size / sizeof(ChangeEvent);
+    uint64_t valid = count;
+    ChangeEvent event;
+    if (count > 0 && readEvent(fd, 0, event) && !knownMagic(event.magic)) {
+        return false;
+    }
+    if (count > 0 && !(readEvent(fd, count - 1, event) && validEvent(event, first + count - 1))) {
+        valid = 0;
+        while (valid < count && readEvent(fd, valid, event) && validEvent(event, first + valid)) {
+            valid++;
+        }
+    }
+    if (valid * sizeof(ChangeEvent) != static_cast<uint64_t>(info.st_size) &&
+        ftruncate(fd, valid * sizeof(ChangeEvent)) != 0) {
+        return false;
+    }
+
+    nextSeq = first + valid;
+    return true;
+}
+
+// Seals the full segment, starts the next one and applies retention
+bool ChangeFeed::rotate() {
+    if (syncFileData(fd) != 0) return false;
+    ::close(fd);
+    fd = -1;
+
+    if (!openSegment(nextSeq)) return false;
+
+    while (segments.size() > retainedSegments) {
+        remove(segmentPath(base, segments.front()).c_str());
+        segments.erase(segments.begin());
+    }
+    return true;
+}
+
+// Stamps event with the next sequence and writes it; lock held
+bool ChangeFeed::writeEvent(ChangeEvent& event) {
+    if (fd < 0) return false;
+    if (nextSeq - segments.back() >= segmentEvents && !rotate()) return false;
+
+    event.sequence = nextSeq;
+    event.checksum = eventChecksum(event);
+    if (write(fd, &event, sizeof(event)) != static_cast<ssize_t>(sizeof(event))) {
+        // Never leave a partial event for readers to trip over
+        ftruncate(fd, (nextSeq - segments.back()) * sizeof(ChangeEvent));
+        return false;
+    }
+    nextSeq++;
+    return true;
+}
+
+uint64_t ChangeFeed::append(ChangeType type, const Book* before, const Book* after) {
+    ChangeEvent event = makeChange(type, before, after);
+    return append(event);
+}
+
+uint64_t ChangeFeed::append(ChangeEvent& event) {
+    lock_guard<mutex> guard(lock);
+    return writeEvent(event) ? event.sequence : 0;
+}
+
+bool ChangeFeed::sync() {
+    lock_guard<mutex> guard(lock);
+    return fd >= 0 && syncFileData(fd) == 0;
+}
+
+bool ChangeFeed::publish() {
+    lock_guard<mutex> guard(lock);
+    uint64_t previous = committed;
+    committed = nextSeq;
+    confirmed.clear();
+    if (!saveMark(true)) {
+        committed = previous;
+        return false;
+    }
+    return true;
+}
+
+void ChangeFeed::publish(uint64_t sequence) {
+    lock_guard<mutex> guard(lock);
+    if (sequence < committed) return;
+    confirmed.insert(sequence);
+    uint64_t previous = committed;
+    while (!confirmed.empty() && *confirmed.begin() == committed) {
+        confirmed.erase(confirmed.begin());
+        committed++;
+    }
+    // A lost mark only hides events until the next publish or recovery
+    if (committed != previous) {
+        saveMark(false);
+    }
+}
+
+/**
+ * Cuts the feed back to sequence and writes it forward again up to
+ * its old end (or past it, for events in keep beyond the end), so
+ * every sequence number keeps the position it had.
+ */
+bool ChangeFeed::rewriteFrom(uint64_t sequence, const vector<ChangeEvent>& keep) {
+    lock_guard<mutex> guard(lock);
+    if (fd < 0) return false;
+    uint64_t end = nextSeq;
+    if (!keep.empty()) end = max(end, keep.back().sequence + 1);
+    sequence = max(sequence, segments.front());
+
+    if (sequence < nextSeq) {
+        // Later segments go entirely, the one holding sequence is cut short
+        while (segments.size() > 1 && segments.back() > sequence) {
+            ::close(fd);
+            fd = -1;
+            remove(segmentPath(base, segments.back()).c_str());
+            segments.pop_back();
+        }
+        if (fd < 0 && !openSegment(segments.back())) return false;
+        if (ftruncate(fd, (sequence - segments.back()) * sizeof(ChangeEvent)) != 0) {
+            return false;
+        }
+        nextSeq = sequence;
+    }
+
+    auto next = lower_bound(keep.begin(), keep.end(), nextSeq,
+                            [](const ChangeEvent& event, uint64_t s) { return event.sequence < s; });
+    while (nextSeq < end) {
+        ChangeEvent event = next != keep.end() && next->sequence == nextSeq ? *next++ : placeholder(nextSeq);
+        if (!writeEvent(event)) return false;
+    }
+    if (syncFileData(fd) != 0) return false;
+
+    committed = nextSeq;
+    confirmed.clear();
+    return saveMark(true);
+}
+
+bool ChangeFeed::discardFrom(uint64_t sequence) {
+    return rewriteFrom(sequence, {});
+}
+
+bool ChangeFeed::readUnpublished(vector<ChangeEvent>& out) const {
+    lock_guard<mutex> guard(lock);
+    uint64_t sequence = max(committed, segments.front());
+    while (sequence < nextSeq) {
+        size_t s = upper_bound(segments.begin(), segments.end(), sequence) - segments.begin() - 1;
+        uint64_t end = s + 1 < segments.size() ? min(nextSeq, segments[s + 1]) : nextSeq;
+        int segment = ::open(segmentPath(base, segments[s]).c_str(), O_RDONLY);
+        if (segment < 0) return false;
+
+        ChangeEvent event;
+        while (sequence < end && readEvent(segment, sequence - segments[s], event) &&
+               validEvent(event, sequence)) {
+            out.push_back(event);
+            sequence++;
+        }
+        ::close(segment);
+        if (sequence < end) return false;
+    }
+    return true;
+}
+
+bool ChangeFeed::truncateBefore(uint64_t sequence) {
+    lock_guard<mutex> guard(lock);
+    while (segments.size() > 1 && segments[1] <= sequence) {
+        if (remove(segmentPath(base, segments.front()).c_str()) != 0) return false;
+        segments.erase(segments.begin());
+    }
+    return true;
+}
+
+uint64_t ChangeFeed::firstSequence() const {
+    lock_guard<mutex> guard(lock);
+    return segments.empty() ? nextSeq : segments.front();
+}
+
+uint64_t ChangeFeed::nextSequence() const {
+    lock_guard<mutex> guard(lock);
+    return nextSeq;
+}
+
+uint64_t ChangeFeed::committedSequence() const {
+    lock_guard<mutex> guard(lock);
+    return committed;
+}
+
+bool readChanges(const string& feedBase, uint64_t from, size_t limit,
+                 vector<ChangeEvent>& out, uint64_t& firstAvailable) {
+    uint64_t committed = readerMark(feedBase);
+    vector<uint64_t> chain = listSegments(feedBase);
+    firstAvailable = chain.empty() ? 1 : chain.front();
+    if (from < firstAvailable) return false;
+    if (chain.empty()) return true;
+
+    // Start in the last segment beginning at or before from
+    size_t s = upper_bound(chain.begin(), chain.end(), from) - chain.begin() - 1;
+    size_t start = out.size();
+    size_t wanted = start + limit;
+    for (; s < chain.size() && out.size() < wanted; s++) {
+        int segment = open(segmentPath(feedBase, chain[s]).c_str(), O_RDONLY);
+        if (segment < 0) {
+            // Retention removed it since the listing
+            if (out.size() == start) {
+                return readChanges(feedBase, from, limit, out, firstAvailable);
+            }
+            break;
+        }
+
+        ChangeEvent event;
+        while (out.size() < wanted && from < committed &&
+               readEvent(segment, from - chain[s], event) && validEvent(event, from)) {
+            if (event.type != static_cast<uint32_t>(ChangeType::Discarded)) {
+                out.push_back(event);
+            }
+            from++;
+        }
+        close(segment);
+
+        // Move on only if this segment really ended where the next begins
+        if (s + 1 < chain.size() && from != chain[s + 1]) break;
+    }
+    return true;
+}
+
+string formatChange(const ChangeEvent& event) {
+    static const char* const names[] = { "unknown", "insert", "update", "delete", "discarded", "restore" };
+    ChangeType type = static_cast<ChangeType>(event.type);
+
+    ostringstream out;
+    out << "{\"seq\":" << event.sequence
+        << ",\"op\":\"" << names[event.type <= 5 ? event.type : 0] << '"'
+        << ",\"time_ns\":" << event.timeNs;
+    if (type == ChangeType::Restore) {
+        out << ",\"point\":" << event.restored.point
+            << ",\"point_seq\":" << event.restored.changeSequence << '}';
+        return out.str();
+    }
+    out << ",\"before\":";
+    if (type == ChangeType::Insert) {
+        out << "null";
+    } else {
+        appendBookJson(out, event.before);
+    }
+    out << ",\"after\":";
+    if (type == ChangeType::Delete) {
+        out << "null";
+    } else {
+        appendBookJson(out, event.after);
+    }
+    out << '}';
+    return out.str();
+}
@@ -0,0 +1,139 @@
+/**
+ * Library Management System - Change Feed
+ * Append-only, sequence-numbered log of record-level changes, so
+ * downstream copies can sync in O(changes) instead of re-exporting
+ * the catalog.
+ *
+ * The feed is a chain of segment files named after the sequence of
+ * their first event (books.cdc.00000000000000000001, ...). Events are
+ * fixed size, so any sequence number maps straight to a file offset.
+ * Only the newest segments are retained; consumers that fall further
+ * behind must re-export and resume from firstSequence().
+ *
+ * Readers only see events below the committed mark kept in
+ * books.cdc.committed, which the engine advances once a write (or a
+ * checkout's journal entry) is durable. Events of a rolled-back write
+ * become Discarded placeholders, so a sequence number is never reused.
+ */
+
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+#include "book.h"
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+constexpr uint64_t CHANGE_SEGMENT_EVENTS = 65536;   // ~15 MiB per segment
+constexpr size_t CHANGE_RETAINED_SEGMENTS = 8;
+
+enum class ChangeType : uint32_t {
+    Insert = 1,
+    Update = 2,
+    Delete = 3,
+    Discarded = 4,      // rolled back; skipped by readers
+    Restore = 5         // the table went back to a backup point
+};
+
+// What a Restore event carries in place of the before image
+struct RestoreMark {
+    uint32_t point;
+    uint32_t reserved;
+    uint64_t changeSequence;    // next sequence when the point was taken
+};
+
+// On-disk event; before is zeroed for inserts, after for deletes.
+// A Restore event has no images: the whole table changed at once.
+struct ChangeEvent {
+    uint32_t magic;         // derived from BOOK_LAYOUT (book.h)
+    uint32_t type;
+    uint64_t sequence;
+    uint64_t timeNs;        // wall clock when the change was logged
+    union {
+        Book before;
+        RestoreMark restored;
+    };
+    Book after;
+    uint64_t checksum;      // FNV-1a of everything above
+};
+
+
+class ChangeFeed {
+private:
+    mutable mutex lock;
+    string base;                  // books.cdc
+    int fd;                       // newest segment, opened O_APPEND
+    int markFd;                   // books.cdc.committed
+    vector<uint64_t> segments;    // first sequence of each segment, ascending
+    uint64_t nextSeq;
+    uint64_t committed;           // readers see sequences below this
+    set<uint64_t> confirmed;      // published out of order, above committed
+    uint64_t segmentEvents;
+    size_t retainedSegments;
+
+    bool openSegment(uint64_t first);
+    bool rotate();
+    bool writeEvent(ChangeEvent& event);
+    bool saveMark(bool durable);
+
+public:
+    ChangeFeed(uint64_t segmentEvents = CHANGE_SEGMENT_EVENTS,
+               size_t retainedSegments = CHANGE_RETAINED_SEGMENTS);
+    ~ChangeFeed();
+
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+    // Drops a torn event left at the end by a crash; events above the
+    // committed mark stay until the owner rewrites or publishes them
+    bool open(const string& feedBase);
+    void close();
+
+    // Writes an event (durable after sync, visible once published);
+    // returns its sequence number, or 0 on failure
+    uint64_t append(ChangeType type, const Book* before, const Book* after);
+    uint64_t append(ChangeEvent& event);    // keeps event.timeNs
+    bool sync();
+    // Lets readers see every event appended so far; call after sync()
+    bool publish();
+    // One event made durable elsewhere (the circulation journal); it is
+    // seen once every event before it has been published as well
+    void publish(uint64_t sequence);
+    // Rewrites every unpublished event from sequence on: the events in
+    // keep (ascending) go back under their own sequence, all others
+    // become Discarded. Syncs and publishes the result.
+    bool rewriteFrom(uint64_t sequence, const vector<ChangeEvent>& keep);
+    // Rolls back a write; its sequence numbers are not handed out again
+    bool discardFrom(uint64_t sequence);
+    // Events appended since the last publish, for crash recovery
+    bool readUnpublished(vector<ChangeEvent>& out) const;
+    // Deletes whole segments that end before sequence
+    bool truncateBefore(uint64_t sequence);
+
+    uint64_t firstSequence() const;
+    uint64_t nextSequence() const;
+    uint64_t committedSequence() const;
+};
+
+// An event stamped with the current time, ready for append()
+ChangeEvent makeChange(ChangeType type, const Book* before, const Book* after);
+
+/**
+ * Reads up to limit published events starting at sequence from, without
+ * disturbing a writer in another process; Discarded placeholders are
+ * skipped. Returns false when events before from have already been
+ * dropped by retention; firstAvailable then tells the caller where the
+ * feed resumes.
+ */
+bool readChanges(const string& feedBase, uint64_t from, size_t limit,
+                 vector<ChangeEvent>& out, uint64_t& firstAvailable);
+
+// One JSON object per event, for the tail command
+string formatChange(const ChangeEvent& event);
+
+#endif
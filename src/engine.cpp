@@ -0,0 +1,1285 @@
+/**
+ * Library Management System - Storage Engine Implementation
+ *
+ * Key points:
+ *   - Records are split by slot into books.hot (id, price, quantity,
+ *     status) and books.cold (title, author); see store.h. An existing
+ *     books.dat is imported on first open
+ *   - Index builds, range indexes and circulation only read books.hot
+ *   - An id -> position index (index.h) is loaded lazily from the
+ *     books.idx snapshot, or rebuilt with one scan when that is stale;
+ *     lookups then read a single record instead of scanning the file
+ *   - Secondary indexes (fuzzy.h, range.h) are built on first use
+ *     and updated by each mutation after that
+ *   - Every mutation rolls back on failure from in-memory undo images
+ *     of the records it overwrote; written slots are also marked for
+ *     the next incremental backup (backup.h)
+ *   - Checkout/return skip the undo images: they rewrite one 16-byte
+ *     hot record in place and rely on the circulation journal (books.log) for durability
+ *   - Top-K reports stream books.hot in parallel slices, each with
+ *     its own bounded heap (topk.h), and only read the winners in full
+ *   - Every mutation publishes record-level events to the change feed
+ *     (changefeed.h); a failed write discards the events it logged
+ */
+
+#include "engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Records moved per read when scanning the table
+    constexpr size_t SCAN_CHUNK = 4096;
+
+    // Unsaved index entries tolerated before the snapshot is rewritten
+    constexpr size_t OVERLAY_LIMIT = 65536;
+
+    // Fuzzy search verifies at most this many candidates per result
+    constexpr size_t FUZZY_CANDIDATES_PER_RESULT = 100;
+    constexpr size_t FUZZY_MIN_CANDIDATES = 1000;
+
+    // Smallest slice of books.hot worth a top-K worker of its own
+    constexpr size_t TOPK_MIN_SLICE = 1 << 18;
+
+    // Range index layout: whole-dollar price buckets, one per quantity
+    constexpr int32_t PRICE_BUCKET_CENTS = 100;
+
+    int32_t priceKey(float price) {
+        return static_cast<int32_t>(lround(price * 100.0f));
+    }
+
+    // Journal size that triggers a checkpoint of books.hot
+    constexpr uint64_t JOURNAL_CHECKPOINT_BYTES = 16 << 20;
+
+    // One redo record per checkout/return: the book, its quantity before
+    // and after, and the change feed event that announced it
+    constexpr uint32_t CIRCULATION_MAGIC = 0x32435243;         // "CRC2"
+    constexpr uint32_t LEGACY_CIRCULATION_MAGIC = 0x43524331;  // "CRC1"
+
+    struct CirculationRecord {
+        uint32_t magic;
+        int32_t id;
+        int32_t quantity;
+        int32_t previous;
+        uint64_t sequence;
+        uint64_t timeNs;
+        uint64_t checksum;
+    };
+
+    // Written before events carried over into the journal: no sequence
+    struct LegacyCirculationRecord {
+        uint32_t magic;
+        int32_t id;
+        int32_t quantity;
+        uint32_t checksum;
+    };
+
+    uint64_t circulationChecksum(const CirculationRecord& entry) {
+        return fnv1a(&entry, offsetof(CirculationRecord, checksum));
+    }
+
+    uint32_t circulationChecksum(const LegacyCirculationRecord& entry) {
+        return static_cast<uint32_t>(fnv1a(&entry, offsetof(LegacyCirculationRecord, checksum)));
+    }
+
+    // Same stored fields; padding and bytes after a terminator are ignored
+    bool sameBook(const Book& a, const Book& b) {
+        return a.id == b.id && a.price == b.price && a.quantity == b.quantity &&
+               strcmp(a.title, b.title) == 0 && strcmp(a.author, b.author) == 0;
+    }
+
+    // books.dat -> books.idx, keeping the names the menu program always used
+    string siblingFile(const string& dataFile, const string& extension) {
+        size_t dot = dataFile.find_last_of('.');
+        size_t slash = dataFile.find_last_of('/');
+        if (dot == string::npos || (slash != string::npos && dot < slash)) {
+            return dataFile + extension;
+        }
+        return dataFile.substr(0, dot) + extension;
+    }
+
+    // Whether two paths reach the same file, through links or spelling
+    bool sameFile(const string& a, const string& b) {
+        struct stat first, second;
+        return stat(a.c_str(), &first) == 0 && stat(b.c_str(), &second) == 0 &&
+               first.st_dev == second.st_dev && first.st_ino == second.st_ino;
+    }
+}
+
+LibraryEngine::LibraryEngine(const string& dataFile) :
+    hotFilename(siblingFile(dataFile, ".hot")),
+    indexFilename(siblingFile(dataFile, ".idx")),
+    journalFilename(siblingFile(dataFile, ".log")),
+    dirtyFilename(siblingFile(dataFile, ".backups") + "/dirty"),
+    backupChain(siblingFile(dataFile, ".backups"),
+                { { "hot", sizeof(HotRecord) }, { "cold", sizeof(ColdRecord) } }),
+    indexLoaded(false),
+    indexDirty(false),
+    dataChanged(false),
+    recordCount(0),
+    maxId(0),
+    generationCount(0),
+    fuzzyLoaded(false),
+    priceIndex(priceKey(MAX_PRICE), PRICE_BUCKET_CENTS),
+    quantityIndex(MAX_QUANTITY, 1),
+    rangeLoaded(false),
+    writeStartSequence(0),
+    undoRecordCount(0) {
+    // Files from another schema would be misread, so they are refused
+    string layoutFile = siblingFile(dataFile, ".layout");
+    LayoutStamp stamp;
+    if (readLayout(layoutFile, stamp)) {
+        if (stamp.layout != BOOK_LAYOUT) {
+            throw runtime_error(layoutFile + ": the data was written with " + to_string(stamp.hotSize) + "/" +
+                                to_string(stamp.coldSize) + "-byte records of another schema; export it with "
+                                "that build and re-import it");
+        }
+    } else if (!writeLayout(layoutFile)) {
+        throw runtime_error("Failed to initialize database");
+    }
+
+    if (!store.open(hotFilename, siblingFile(dataFile, ".cold"), dataFile)) {
+        throw runtime_error(store.damaged() ? hotFilename + " holds records missing from " +
+                                              siblingFile(dataFile, ".cold") + "; restore a backup" :
+                                              "Failed to initialize database");
+    }
+    if (!journal.open(journalFilename)) {
+        throw runtime_error("Failed to initialize database");
+    }
+    if (!changes.open(siblingFile(dataFile, ".cdc"))) {
+        throw runtime_error("Unable to open the change feed; its events may be of another schema");
+    }
+}
+
+LibraryEngine::~LibraryEngine() {
+    unique_lock<shared_mutex> writer(stateLock);
+    if (indexLoaded) {
+        checkpointJournal();
+        if (indexDirty || dataChanged) {
+            saveIndex();
+        }
+        DataFingerprint data;
+        if (fingerprintFile(hotFilename, data)) {
+            dirty.save(dirtyFilename, data);
+        }
+    }
+    journal.close();
+    changes.close();
+    store.close();
+}
+
+shared_lock<shared_mutex> LibraryEngine::sharedAccess() const {
+    if (!indexLoaded.load(memory_order_acquire)) {
+        unique_lock<shared_mutex> writer(stateLock);
+        ensureIndex();
+    }
+    return shared_lock<shared_mutex>(stateLock);
+}
+
+// Shared access once a lazily built secondary index is ready; only
+// the build itself runs exclusively
+shared_lock<shared_mutex> LibraryEngine::sharedAccessBuilt(const atomic<bool>& loaded,
+                                                           void (LibraryEngine::*build)() const) const {
+    auto reader = sharedAccess();
+    while (!loaded) {
+        reader.unlock();
+        {
+            auto writer = exclusiveAccess();
+            (this->*build)();
+        }
+        reader.lock();
+    }
+    return reader;
+}
+
+unique_lock<shared_mutex> LibraryEngine::exclusiveAccess() const {
+    unique_lock<shared_mutex> writer(stateLock);
+    ensureIndex();
+    return writer;
+}
+
+/**
+ * Makes the index usable, preferring the saved snapshot.
+ * Called by every operation that needs an id lookup or the record
+ * count, so opening the engine itself never touches books.idx.
+ * Circulation left in the journal by a crash is replayed here.
+ */
+void LibraryEngine::ensureIndex() const {
+    if (indexLoaded) return;
+
+    DataFingerprint data;
+    IndexHeader header;
+    bool identified = fingerprintFile(hotFilename, data);
+    if (identified &&
+        index.load(indexFilename, data, header) &&
+        header.recordSize == sizeof(HotRecord)) {
+        recordCount = header.recordCount;
+        maxId = header.maxId;
+        generationCount = header.generation;
+        indexDirty = false;
+        dataChanged = false;
+        indexLoaded = true;
+    } else {
+        rebuildIndex();
+        saveIndex();
+    }
+
+    // Slots written since the last backup, if the saved map still applies
+    if (identified) {
+        dirty.load(dirtyFilename, data);
+    }
+    dirty.resize(recordCount);
+
+    recoverJournal();
+}
+
+/**
+ * Builds the id -> position index with one sequential pass over
+ * books.hot.
+ * If an id occurs more than once the first record wins,
+ * matching the old linear search behaviour. Secondary indexes are
+ * left to the caller, which resets or renumbers them.
+ */
+void LibraryEngine::rebuildIndex() const {
+    vector<IndexEntry> entries;
+    recordCount = 0;
+    maxId = 0;
+
+    store.forEachHot([&](uint32_t slot, const HotRecord& record) {
+        entries.push_back({ record.id, slot });
+        maxId = max(maxId, record.id);
+        recordCount = slot + 1;
+    });
+
+    auto byId = [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; };
+    stable_sort(entries.begin(), entries.end(), byId);
+    entries.erase(unique(entries.begin(), entries.end(),
+                         [](const IndexEntry& a, const IndexEntry& b) { return a.id == b.id; }),
+                  entries.end());
+
+    index.reset(move(entries));
+    indexDirty = true;
+    indexLoaded = true;
+}
+
+void LibraryEngine::ensureFuzzyIndex() const {
+    if (fuzzyLoaded) return;
+
+    store.forEach([&](uint32_t slot, const Book& record) {
+        fuzzyIndex.add(slot, record);
+    });
+    fuzzyLoaded = true;
+}
+
+void LibraryEngine::ensureRangeIndexes() const {
+    if (rangeLoaded) return;
+
+    store.forEachHot([&](uint32_t slot, const HotRecord& record) {
+        priceIndex.add(slot, priceKey(record.price));
+        quantityIndex.add(slot, record.quantity);
+    });
+    rangeLoaded = true;
+}
+
+void LibraryEngine::resetSecondaryIndexes() const {
+    fuzzyIndex.clear();
+    fuzzyLoaded = false;
+    priceIndex.clear();
+    quantityIndex.clear();
+    rangeLoaded = false;
+}
+
+// Follows a compaction: slotMap[old slot] is the new slot, or UINT32_MAX
+void LibraryEngine::renumberSecondary(const vector<uint32_t>& slotMap) const {
+    if (fuzzyLoaded) {
+        fuzzyIndex.renumber(slotMap);
+    }
+    if (rangeLoaded) {
+        lock_guard<mutex> indexGuard(secondaryLock);
+        priceIndex.renumber(slotMap);
+        quantityIndex.renumber(slotMap);
+    }
+}
+
+// Mirrors a record written at slot into whichever indexes are loaded
+void LibraryEngine::indexSecondary(uint32_t slot, const Book& record) const {
+    if (fuzzyLoaded) {
+        fuzzyIndex.add(slot, record);
+    }
+    if (rangeLoaded) {
+        priceIndex.add(slot, priceKey(record.price));
+        quantityIndex.add(slot, record.quantity);
+    }
+}
+
+void LibraryEngine::unindexSecondary(uint32_t slot, const Book& record) const {
+    if (fuzzyLoaded) {
+        fuzzyIndex.remove(slot, record);
+    }
+    if (rangeLoaded) {
+        priceIndex.remove(slot);
+        quantityIndex.remove(slot);
+    }
+}
+
+/**
+ * Writes books.idx for the current books.hot. Only the header is
+ * rewritten when records changed in place but no id moved.
+ */
+bool LibraryEngine::saveIndex() const {
+    DataFingerprint data;
+    if (!fingerprintFile(hotFilename, data)) return false;
+
+    IndexHeader header = {};
+    header.recordSize = sizeof(HotRecord);
+    header.generation = generationCount;
+    header.recordCount = recordCount;
+    header.maxId = maxId;
+
+    bool saved = indexDirty ? index.save(indexFilename, data, header)
+                            : index.saveHeader(indexFilename, data, header);
+    if (saved) {
+        indexDirty = false;
+        dataChanged = false;
+    }
+    return saved;
+}
+
+/**
+ * Brings the record files and the change feed back in step after a
+ * crash:
+ * 1. Circulation records are re-applied in feed order. Each holds the
+ *    quantity before and after the change, so replaying one that
+ *    already reached books.hot is harmless and its feed event can be
+ *    rebuilt exactly if it was lost
+ * 2. Other unpublished events belong to a write cut short by the
+ *    crash. They are kept where their change reached the files (a
+ *    delete past its swap, appended records) and become Discarded
+ *    placeholders otherwise
+ * A torn record ends the replay. Records from before the journal
+ * carried sequences (CRC1) are published as new events.
+ */
+bool LibraryEngine::recoverJournal() const {
+    vector<char> log;
+    if (!journal.readAll(log)) return false;
+
+    vector<CirculationRecord> entries;
+    vector<LegacyCirculationRecord> legacy;
+    size_t offset = 0;
+    while (offset + sizeof(uint32_t) <= log.size()) {
+        uint32_t magic;
+        memcpy(&magic, log.data() + offset, sizeof(magic));
+        if (magic == CIRCULATION_MAGIC && offset + sizeof(CirculationRecord) <= log.size()) {
+            CirculationRecord entry;
+            memcpy(&entry, log.data() + offset, sizeof(entry));
+            if (entry.checksum != circulationChecksum(entry)) break;
+            entries.push_back(entry);
+            offset += sizeof(entry);
+        } else if (magic == LEGACY_CIRCULATION_MAGIC && offset + sizeof(LegacyCirculationRecord) <= log.size()) {
+            LegacyCirculationRecord entry;
+            memcpy(&entry, log.data() + offset, sizeof(entry));
+            if (entry.checksum != circulationChecksum(entry)) break;
+            legacy.push_back(entry);
+            offset += sizeof(entry);
+        } else {
+            break;
+        }
+    }
+    // Journal order is group-commit order; per book it matches feed order
+    sort(entries.begin(), entries.end(), [](const CirculationRecord& a, const CirculationRecord& b) {
+        return a.sequence < b.sequence;
+    });
+
+    uint64_t from = changes.committedSequence();
+    vector<ChangeEvent> unpublished;
+    if (!changes.readUnpublished(unpublished)) return false;
+
+    size_t applied = 0;
+    map<uint64_t, ChangeEvent> kept;
+    for (const CirculationRecord& entry : entries) {
+        uint32_t slot;
+        Book current;
+        if (!findSlot(entry.id, slot) || !readSlot(slot, current)) continue;
+        Book before = current;
+        before.quantity = entry.previous;
+        setStatus(before);
+        Book record = current;
+        record.quantity = entry.quantity;
+        setStatus(record);
+        if (!store.writeHot(slot, hotPart(record))) return false;
+        dirty.mark(slot);
+        applied++;
+
+        if (entry.sequence >= from) {
+            ChangeEvent event = makeChange(ChangeType::Update, &before, &record);
+            event.sequence = entry.sequence;
+            event.timeNs = entry.timeNs;
+            kept[entry.sequence] = event;
+        }
+    }
+    for (const ChangeEvent& event : unpublished) {
+        if (!kept.count(event.sequence) && changeReachedStore(event)) {
+            kept[event.sequence] = event;
+        }
+    }
+    if (!unpublished.empty() || !kept.empty()) {
+        vector<ChangeEvent> events;
+        for (const auto& entry : kept) {
+            events.push_back(entry.second);
+        }
+        if (!changes.rewriteFrom(from, events)) return false;
+    }
+
+    for (const LegacyCirculationRecord& entry : legacy) {
+        uint32_t slot;
+        Book before;
+        if (!findSlot(entry.id, slot) || !readSlot(slot, before)) continue;
+        Book record = before;
+        record.quantity = entry.quantity;
+        setStatus(record);
+        if (!store.writeHot(slot, hotPart(record))) return false;
+        if (!changes.append(ChangeType::Update, &before, &record)) return false;
+        dirty.mark(slot);
+        applied++;
+    }
+
+    if (applied > 0) {
+        generationCount++;
+        dataChanged = true;
+    }
+    return checkpointJournal();
+}
+
+// Whether an event left unpublished by a crash describes what the files now hold
+bool LibraryEngine::changeReachedStore(const ChangeEvent& event) const {
+    uint32_t slot;
+    Book current;
+    switch (static_cast<ChangeType>(event.type)) {
+        case ChangeType::Insert:
+        case ChangeType::Update:
+            return findSlot(event.after.id, slot) && readSlot(slot, current) && sameBook(current, event.after);
+        case ChangeType::Delete:
+            return !findSlot(event.before.id, slot);
+        default:
+            return false;
+    }
+}
+
+// Makes both record files and the change feed durable, lets feed
+// readers see every event, and only then empties the circulation journal
+bool LibraryEngine::checkpointJournal() const {
+    if (journal.size() == 0 && !journal.hasFailed() &&
+        changes.committedSequence() == changes.nextSequence()) {
+        return true;
+    }
+    return changes.sync() && store.sync() && changes.publish() && journal.truncate();
+}
+
+bool LibraryEngine::fail(const string& reason) {
+    lock_guard<mutex> guard(errorLock);
+    error = reason;
+    return false;
+}
+
+void LibraryEngine::clearError() {
+    lock_guard<mutex> guard(errorLock);
+    error.clear();
+}
+
+/**
+ * Rollback no longer needs a copy of the whole database: in-place
+ * writes save the record they overwrite (undoImages), appends are
+ * undone by cutting the file back to undoRecordCount, and deletes
+ * only swap in the new record files once everything else has succeeded.
+ */
+bool LibraryEngine::beginWrite() {
+    if (!checkpointJournal()) {
+        return fail("Unable to checkpoint circulation journal");
+    }
+    undoImages.clear();
+    undoRecordCount = recordCount;
+    writeStartSequence = changes.nextSequence();
+    return true;
+}
+
+// The change feed is made durable, then shown to readers, before the
+// write counts as done
+bool LibraryEngine::commitWrite() {
+    if (!changes.sync() || !changes.publish()) {
+        return abortWrite("Unable to write change feed");
+    }
+    return finishWrite();
+}
+
+bool LibraryEngine::finishWrite() {
+    generationCount++;
+    dataChanged = true;
+
+    // Fold a large overlay back into the snapshot so lookups stay fast
+    if (index.overlaySize() > OVERLAY_LIMIT) {
+        index.reset(index.merged());
+        saveIndex();
+    }
+    clearError();
+    return true;
+}
+
+bool LibraryEngine::abortWrite(const string& reason) {
+    changes.discardFrom(writeStartSequence);
+    dirty.resize(undoRecordCount);
+    for (auto it = undoImages.rbegin(); it != undoImages.rend(); ++it) {
+        writeSlot(it->first, it->second);
+    }
+    undoImages.clear();
+    if (!store.truncate(undoRecordCount)) {
+        return fail(reason + " (rollback incomplete)");
+    }
+    // Undo images went back without passing through the indexes
+    rebuildIndex();
+    resetSecondaryIndexes();
+    return fail(reason);
+}
+
+bool LibraryEngine::findSlot(int id, uint32_t& slot) const {
+    return index.find(id, slot);
+}
+
+bool LibraryEngine::readSlot(size_t slot, Book& out) const {
+    return store.read(slot, out);
+}
+
+bool LibraryEngine::writeSlot(size_t slot, const Book& record) {
+    return store.write(slot, record);
+}
+
+/**
+ * Deleting keeps the files dense: surviving records are staged into
+ * new hot and cold files which then replace the live ones. Survivors
+ * keep their order, so the secondary indexes are renumbered in place
+ * rather than rebuilt from the files.
+ */
+bool LibraryEngine::rewriteWithout(const vector<int>& ids) {
+    unordered_set<int> doomed(ids.begin(), ids.end());
+
+    if (!beginWrite()) return false;
+
+    vector<Book> removed;
+    vector<uint32_t> slotMap;
+    slotMap.reserve(recordCount);
+    size_t firstRemoved = recordCount;
+    uint32_t kept = 0;
+    bool staged = store.stage([&](const Book& record) {
+        if (doomed.count(record.id)) {
+            removed.push_back(record);
+            firstRemoved = min(firstRemoved, slotMap.size());
+            slotMap.push_back(UINT32_MAX);
+            return false;
+        }
+        slotMap.push_back(kept++);
+        return true;
+    });
+
+    bool logged = staged;
+    for (size_t i = 0; logged && i < removed.size(); i++) {
+        logged = changes.append(ChangeType::Delete, &removed[i], nullptr) != 0;
+    }
+
+    // The swap is the commit point, so the feed must be durable first
+    if (!logged || !changes.sync() || !store.commitStaged()) {
+        store.discardStaged();
+        return abortWrite("Unable to update database");
+    }
+
+    // Every record after the first removed one has moved down, so the
+    // next backup copies all of them: a delete near the front of a
+    // large catalog makes it a full copy (dirty past half the records)
+    rebuildIndex();
+    renumberSecondary(slotMap);
+    undoRecordCount = recordCount;
+    dirty.markRange(firstRemoved, recordCount);
+
+    // Past the swap the delete has happened and its events are durable,
+    // so nothing may discard them: a publish that fails twice is left to
+    // the next write's checkpoint, or to recovery after a crash
+    if (!changes.publish()) {
+        changes.publish();
+    }
+    return finishWrite();
+}
+
+bool LibraryEngine::applyPatch(Book& record, const BookPatch& patch) {
+    if (patch.title) {
+        if (!validateTitle(*patch.title)) return fail("Invalid title");
+        safeStrCopy(record.title, *patch.title);
+    }
+    if (patch.author) {
+        if (!validateAuthor(*patch.author)) return fail("Invalid author");
+        safeStrCopy(record.author, *patch.author);
+    }
+    if (patch.price) {
+        if (!validatePrice(*patch.price)) return fail("Invalid price");
+        record.price = *patch.price;
+    }
+    if (patch.quantity) {
+        if (!validateQuantity(*patch.quantity)) return fail("Invalid quantity");
+        record.quantity = *patch.quantity;
+    }
+    setStatus(record);
+    return true;
+}
+
+bool LibraryEngine::get(int id, Book& out) const {
+    auto reader = sharedAccess();
+    uint32_t slot;
+    if (!findSlot(id, slot)) {
+        return false;
+    }
+    lock_guard<mutex> recordGuard(recordLocks[slot % RECORD_LOCKS]);
+    return readSlot(slot, out);
+}
+
+bool LibraryEngine::put(const Book& record) {
+    return putBatch(vector<Book>(1, record));
+}
+
+bool LibraryEngine::update(int id, const BookPatch& patch) {
+    return updateBatch({ make_pair(id, patch) });
+}
+
+bool LibraryEngine::erase(int id) {
+    return eraseBatch(vector<int>(1, id));
+}
+
+void LibraryEngine::scan(const function<bool(const Book&)>& predicate,
+                         const function<bool(const Book&)>& callback) const {
+    vector<Book> chunk;
+    for (size_t first = 0; ; first += SCAN_CHUNK) {
+        size_t count;
+        {
+            auto reader = sharedAccess();
+            if (first >= recordCount) break;
+            count = min(SCAN_CHUNK, recordCount - first);
+            if (!store.readRange(first, count, chunk)) break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (predicate && !predicate(chunk[i])) continue;
+            if (!callback(chunk[i])) return;
+        }
+    }
+}
+
+size_t LibraryEngine::readRange(size_t first, size_t count, vector<Book>& out) const {
+    out.clear();
+    auto reader = sharedAccess();
+    if (first >= recordCount) return 0;
+    count = min(count, recordCount - first);
+    if (!store.readRange(first, count, out)) {
+        out.clear();
+    }
+    return out.size();
+}
+
+size_t LibraryEngine::getBatch(const vector<int>& ids, vector<Book>& out) const {
+    auto reader = sharedAccess();
+    size_t found = 0;
+    Book record;
+    for (int id : ids) {
+        uint32_t slot;
+        if (!findSlot(id, slot)) continue;
+        // Circulation rewrites quantities under the record lock only
+        unique_lock<mutex> recordGuard(recordLocks[slot % RECORD_LOCKS]);
+        if (readSlot(slot, record)) {
+            recordGuard.unlock();
+            out.push_back(record);
+            found++;
+        }
+    }
+    return found;
+}
+
+bool LibraryEngine::putBatch(const vector<Book>& records) {
+    if (records.empty()) return true;
+
+    auto writer = exclusiveAccess();
+    vector<Book> pending;
+    pending.reserve(records.size());
+    unordered_set<int> batchIds;
+    for (const Book& record : records) {
+        uint32_t existing;
+        if (record.id <= 0 || findSlot(record.id, existing) || !batchIds.insert(record.id).second) {
+            return fail("Duplicate or invalid book ID " + to_string(record.id));
+        }
+        Book normalised = record;
+        terminateText(normalised);
+        if (!validateRecord(normalised)) {
+            return fail("Invalid field values for book ID " + to_string(record.id));
+        }
+        setStatus(normalised);
+        pending.push_back(normalised);
+    }
+
+    if (!beginWrite()) return false;
+
+    if (!store.append(recordCount, pending)) {
+        return abortWrite("Failed to write book record");
+    }
+    for (const Book& record : pending) {
+        if (!changes.append(ChangeType::Insert, nullptr, &record)) {
+            return abortWrite("Unable to write change feed");
+        }
+    }
+    indexDirty = true;
+    for (const Book& record : pending) {
+        indexSecondary(static_cast<uint32_t>(recordCount), record);
+        index.insert(record.id, static_cast<uint32_t>(recordCount++));
+        maxId = max(maxId, record.id);
+    }
+    dirty.resize(recordCount);
+    dirty.markRange(undoRecordCount, recordCount);
+    return commitWrite();
+}
+
+bool LibraryEngine::updateBatch(const vector<pair<int, BookPatch>>& patches) {
+    if (patches.empty()) return true;
+
+    // Resolve every patch before touching the file; later patches
+    // to the same id build on the earlier ones
+    auto writer = exclusiveAccess();
+    struct Change {
+        uint32_t slot;
+        Book before;
+        Book after;
+    };
+    vector<Change> pending;
+    unordered_map<int, size_t> pendingIndex;
+    for (const auto& entry : patches) {
+        uint32_t slot;
+        if (!findSlot(entry.first, slot)) {
+            return fail("Book ID " + to_string(entry.first) + " not found");
+        }
+        auto seen = pendingIndex.find(entry.first);
+        if (seen == pendingIndex.end()) {
+            Book current;
+            if (!readSlot(slot, current)) {
+                return fail("Failed to read book record");
+            }
+            seen = pendingIndex.emplace(entry.first, pending.size()).first;
+            pending.push_back({ slot, current, current });
+        }
+        if (!applyPatch(pending[seen->second].after, entry.second)) {
+            return false;
+        }
+    }
+
+    if (!beginWrite()) return false;
+
+    for (const Change& change : pending) {
+        undoImages.emplace_back(change.slot, change.before);
+        dirty.mark(change.slot);
+        if (!writeSlot(change.slot, change.after) ||
+            !changes.append(ChangeType::Update, &change.before, &change.after)) {
+            return abortWrite("Failed to write book record");
+        }
+        unindexSecondary(change.slot, change.before);
+        indexSecondary(change.slot, change.after);
+    }
+    return commitWrite();
+}
+
+bool LibraryEngine::eraseBatch(const vector<int>& ids) {
+    if (ids.empty()) return true;
+
+    auto writer = exclusiveAccess();
+    for (int id : ids) {
+        uint32_t slot;
+        if (!findSlot(id, slot)) {
+            return fail("Book ID " + to_string(id) + " not found");
+        }
+    }
+    return rewriteWithout(ids);
+}
+
+CirculationStatus LibraryEngine::checkout(int id) {
+    return adjustQuantity(id, -1);
+}
+
+CirculationStatus LibraryEngine::returnBook(int id) {
+    return adjustQuantity(id, +1);
+}
+
+/**
+ * Circulation fast path:
+ * 1. Shared engine lock, so checkouts on different books run in parallel
+ * 2. Striped record lock around the read-modify-write of quantity
+ * 3. Only the 16-byte hot record is rewritten; the cold record is
+ *    read for the change feed images but never written
+ * 4. The change feed event and the new quantity are journaled before
+ *    the record lock is released, which keeps their order equal to
+ *    write order for each book
+ * 5. The caller then waits, unlocked, for a group commit of the
+ *    journal; books.hot itself is only synced at checkpoints
+ * 6. Once the journal record is durable the event is published to feed
+ *    readers; recovery can rebuild it from the record alone
+ */
+CirculationStatus LibraryEngine::adjustQuantity(int id, int delta) {
+    uint64_t ticket;
+    uint64_t sequence;
+    bool durable;
+    {
+        auto reader = sharedAccess();
+        uint32_t slot;
+        if (!findSlot(id, slot)) {
+            return CirculationStatus::NotFound;
+        }
+
+        unique_lock<mutex> recordGuard(recordLocks[slot % RECORD_LOCKS]);
+        Book before;
+        if (!readSlot(slot, before)) {
+            return CirculationStatus::IoError;
+        }
+
+        int quantity = before.quantity + delta;
+        if (quantity < MIN_QUANTITY) return CirculationStatus::OutOfStock;
+        if (quantity > MAX_QUANTITY) return CirculationStatus::AtCapacity;
+
+        Book record = before;
+        record.quantity = quantity;
+        setStatus(record);
+        if (!store.writeHot(slot, hotPart(record))) {
+            return CirculationStatus::IoError;
+        }
+        dirty.mark(slot);
+        ChangeEvent event = makeChange(ChangeType::Update, &before, &record);
+        sequence = changes.append(event);
+        if (!sequence) {
+            store.writeHot(slot, hotPart(before));
+            return CirculationStatus::IoError;
+        }
+
+        CirculationRecord entry = { CIRCULATION_MAGIC, id, quantity, before.quantity, sequence, event.timeNs, 0 };
+        entry.checksum = circulationChecksum(entry);
+        ticket = journal.append(&entry, sizeof(entry));
+
+        if (rangeLoaded) {
+            lock_guard<mutex> indexGuard(secondaryLock);
+            quantityIndex.add(slot, quantity);
+        }
+        generationCount++;
+        dataChanged = true;
+        recordGuard.unlock();
+
+        // The shared lock stays held until the journal is durable,
+        // so no checkpoint can truncate it underneath this record.
+        // A failed sync cannot be undone here: other circulation may
+        // already sit on top of this quantity, so report it instead.
+        durable = journal.waitDurable(ticket);
+        if (durable) {
+            changes.publish(sequence);
+        }
+    }
+
+    // Keep the redo journal short, and after a failed sync make the
+    // records durable by checkpointing, which clears the failure;
+    // skipped if anyone else holds the engine
+    if (!durable || journal.size() > JOURNAL_CHECKPOINT_BYTES) {
+        unique_lock<shared_mutex> writer(stateLock, try_to_lock);
+        if (writer.owns_lock() && checkpointJournal()) {
+            durable = true;
+        }
+    }
+    return durable ? CirculationStatus::Ok : CirculationStatus::NotDurable;
+}
+
+/**
+ * Fuzzy search:
+ * 1. Candidates must share enough trigrams with the query
+ * 2. Only the best-overlapping few are read from disk
+ * 3. Survivors are ranked by edit distance, then by how close
+ *    the matching field's length is to the query
+ * Only a first-time index build is exclusive; the query itself runs
+ * under the shared lock beside lookups and circulation.
+ */
+vector<FuzzyMatch> LibraryEngine::fuzzySearch(const string& query, size_t limit) const {
+    vector<FuzzyMatch> matches;
+    vector<pair<size_t, size_t>> ranking;  // (length gap, match position)
+    string pattern = normaliseText(query);
+    if (pattern.empty() || limit == 0) return matches;
+    if (pattern.size() > 64) pattern.resize(64);
+
+    auto reader = sharedAccessBuilt(fuzzyLoaded, &LibraryEngine::ensureFuzzyIndex);
+
+    int maxDistance = max(1, static_cast<int>(pattern.size()) / 4);
+    vector<uint32_t> grams;
+    textTrigrams(pattern, grams);
+    // Each edit breaks up to three trigrams, the padded ends two more
+    int minShared = max(1, static_cast<int>(grams.size()) - 3 * maxDistance - 2);
+    size_t candidateLimit = max(limit * FUZZY_CANDIDATES_PER_RESULT, FUZZY_MIN_CANDIDATES);
+
+    for (const auto& candidate : fuzzyIndex.candidates(grams, minShared, candidateLimit)) {
+        Book record;
+        uint32_t current;
+        {
+            lock_guard<mutex> recordGuard(recordLocks[candidate.first % RECORD_LOCKS]);
+            if (!readSlot(candidate.first, record)) continue;
+        }
+        if (!findSlot(record.id, current) || current != candidate.first) {
+            continue;
+        }
+        string title = normaliseText(string(record.title, strnlen(record.title, MAX_TITLE_LENGTH)));
+        string author = normaliseText(string(record.author, strnlen(record.author, MAX_AUTHOR_LENGTH)));
+        int titleDistance = substringEditDistance(pattern, title);
+        int authorDistance = substringEditDistance(pattern, author);
+        int distance = min(titleDistance, authorDistance);
+        if (distance > maxDistance) continue;
+
+        const string& field = titleDistance <= authorDistance ? title : author;
+        size_t gap = field.size() > pattern.size() ? field.size() - pattern.size()
+                                                   : pattern.size() - field.size();
+        float score = 1.0f - static_cast<float>(distance) / pattern.size();
+        ranking.emplace_back(gap, matches.size());
+        matches.push_back({ record, distance, score });
+    }
+
+    sort(ranking.begin(), ranking.end(), [&](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) {
+        const FuzzyMatch& left = matches[a.second];
+        const FuzzyMatch& right = matches[b.second];
+        if (left.distance != right.distance) return left.distance < right.distance;
+        if (a.first != b.first) return a.first < b.first;
+        return left.book.id < right.book.id;
+    });
+
+    vector<FuzzyMatch> best;
+    for (size_t i = 0; i < ranking.size() && i < limit; i++) {
+        best.push_back(matches[ranking[i].second]);
+    }
+    return best;
+}
+
+/**
+ * Range queries start from whichever index promises fewer matches
+ * and test the other bound against the second index in memory,
+ * so only records that satisfy both bounds are read from disk.
+ * The query runs under the shared lock; circulation may change a
+ * quantity between the index lookup and the read, so every record
+ * read is checked against the filter again.
+ * Matches are collected first; callbacks run without the engine lock.
+ */
+size_t LibraryEngine::rangeQuery(const RangeFilter& filter,
+                                 const function<bool(const Book&)>& callback) const {
+    int32_t priceLow = priceKey(filter.minPrice);
+    int32_t priceHigh = priceKey(filter.maxPrice);
+    auto inRange = [&](const Book& record) {
+        int32_t price = priceKey(record.price);
+        return price >= priceLow && price <= priceHigh &&
+               record.quantity >= filter.minQuantity && record.quantity <= filter.maxQuantity;
+    };
+
+    vector<Book> matches;
+    {
+        auto reader = sharedAccessBuilt(rangeLoaded, &LibraryEngine::ensureRangeIndexes);
+
+        vector<uint32_t> slots;
+        {
+            lock_guard<mutex> indexGuard(secondaryLock);
+            bool byQuantity = quantityIndex.estimate(filter.minQuantity, filter.maxQuantity) <=
+                              priceIndex.estimate(priceLow, priceHigh);
+            vector<uint32_t> candidates = byQuantity ?
+                quantityIndex.query(filter.minQuantity, filter.maxQuantity) :
+                priceIndex.query(priceLow, priceHigh);
+            for (uint32_t slot : candidates) {
+                bool inOther = byQuantity ?
+                    priceIndex.contains(slot, priceLow, priceHigh) :
+                    quantityIndex.contains(slot, filter.minQuantity, filter.maxQuantity);
+                if (inOther) slots.push_back(slot);
+            }
+        }
+
+        Book record;
+        for (uint32_t slot : slots) {
+            lock_guard<mutex> recordGuard(recordLocks[slot % RECORD_LOCKS]);
+            if (readSlot(slot, record) && inRange(record)) {
+                matches.push_back(record);
+            }
+        }
+    }
+
+    size_t visited = 0;
+    for (const Book& record : matches) {
+        visited++;
+        if (!callback(record)) break;
+    }
+    return visited;
+}
+
+vector<Book> LibraryEngine::lowStock(int threshold) const {
+    RangeFilter filter;
+    filter.maxQuantity = threshold;
+
+    vector<Book> result;
+    rangeQuery(filter, [&](const Book& record) {
+        result.push_back(record);
+        return true;
+    });
+    return result;
+}
+
+/**
+ * Top-K:
+ * 1. books.hot is cut into one contiguous slice per worker
+ * 2. Each worker streams its slice in chunks through a heap of at
+ *    most limit entries, O(N log K) time and O(K) memory overall
+ * 3. The partial heaps are merged and only the winners are read
+ *    with their cold fields
+ * Runs under the shared lock, so circulation continues meanwhile;
+ * a record changed mid-scan is ranked by whichever value was read.
+ */
+vector<Book> LibraryEngine::topK(RankKey key, bool highest, size_t limit, unsigned threads) const {
+    vector<Book> result;
+    auto reader = sharedAccess();
+    if (limit == 0 || recordCount == 0) return result;
+    limit = min(limit, recordCount);
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    size_t workers = min<size_t>(threads, (recordCount + TOPK_MIN_SLICE - 1) / TOPK_MIN_SLICE);
+    size_t slice = (recordCount + workers - 1) / workers;
+
+    vector<TopKHeap> heaps(workers, TopKHeap(limit, highest));
+    auto rankSlice = [&](size_t worker) {
+        size_t end = min(recordCount, (worker + 1) * slice);
+        vector<HotRecord> chunk;
+        for (size_t first = worker * slice; first < end; first += SCAN_CHUNK) {
+            size_t count = min(SCAN_CHUNK, end - first);
+            if (!store.readHotRange(first, count, chunk)) return;
+            for (size_t i = 0; i < count; i++) {
+                heaps[worker].offer({ rankValue(key, chunk[i]), chunk[i].id,
+                                      static_cast<uint32_t>(first + i) });
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (size_t worker = 1; worker < workers; worker++) {
+        pool.emplace_back(rankSlice, worker);
+    }
+    rankSlice(0);
+    for (thread& worker : pool) {
+        worker.join();
+    }
+    for (size_t worker = 1; worker < workers; worker++) {
+        heaps[0].merge(heaps[worker]);
+    }
+
+    for (const RankedSlot& entry : heaps[0].sorted()) {
+        Book record;
+        lock_guard<mutex> recordGuard(recordLocks[entry.slot % RECORD_LOCKS]);
+        if (readSlot(entry.slot, record)) {
+            result.push_back(record);
+        }
+    }
+    return result;
+}
+
+/**
+ * Takes the next backup point. A delta only copies the records
+ * written since the previous point; a full copy is taken instead when
+ * there is no chain yet, the dirty map was lost, the chain is long,
+ * or most of the catalog changed anyway.
+ */
+bool LibraryEngine::backup(BackupInfo* created) {
+    auto writer = exclusiveAccess();
+    if (!checkpointJournal() || !backupChain.open()) {
+        return fail("Unable to prepare backup");
+    }
+
+    BackupInfo info;
+    bool full = dirty.isUnknown() || backupChain.list().empty() ||
+                backupChain.deltasSinceFull() >= BACKUP_DELTAS_PER_FULL ||
+                dirty.dirtyCount() * 2 > recordCount;
+    bool saved = full ?
+        backupChain.createFull(store.files(), recordCount, changes.nextSequence(), info) :
+        backupChain.createDelta(store.files(), recordCount, dirty.ranges(), changes.nextSequence(), info);
+    if (!saved) {
+        return fail("Unable to write backup");
+    }
+
+    dirty.clear(recordCount);
+    if (created) *created = info;
+    clearError();
+    return true;
+}
+
+vector<BackupInfo> LibraryEngine::backups() const {
+    auto writer = exclusiveAccess();
+    backupChain.open();
+    return backupChain.list();
+}
+
+// The copy must not land on the open database: the columns would be
+// replaced underneath the engine, its index and its journal
+bool LibraryEngine::restoreTo(uint32_t point, const string& target) {
+    auto writer = exclusiveAccess();
+    string hot = siblingFile(target, ".hot");
+    string cold = siblingFile(target, ".cold");
+    string liveCold = siblingFile(hotFilename, ".cold");
+    for (const string& path : { hot, cold }) {
+        if (sameFile(path, hotFilename) || sameFile(path, liveCold)) {
+            return fail(target + " is the open database; use restore without --to");
+        }
+    }
+    if (!backupChain.open() || !backupChain.restore(point, { hot, cold })) {
+        return fail("Backup point " + to_string(point) + " cannot be restored");
+    }
+    clearError();
+    return true;
+}
+
+/**
+ * Rolls the live database back to a backup point and announces it on
+ * the change feed with a Restore event naming the point and its change
+ * sequence; consumers re-export from there. The event is published
+ * before the swap: a restore that then fails only costs consumers a
+ * needless re-export, a missing event would leave them diverged.
+ * The next backup is a full copy.
+ */
+bool LibraryEngine::restore(uint32_t point) {
+    auto writer = exclusiveAccess();
+    if (!checkpointJournal()) {
+        return fail("Unable to checkpoint circulation journal");
+    }
+    if (!backupChain.open() ||
+        !backupChain.restore(point, { store.stagedHotFile(), store.stagedColdFile() })) {
+        store.discardStaged();
+        return fail("Backup point " + to_string(point) + " cannot be restored");
+    }
+
+    uint64_t first = changes.nextSequence();
+    ChangeEvent event = makeChange(ChangeType::Restore, nullptr, nullptr);
+    for (const BackupInfo& info : backupChain.list()) {
+        if (info.point == point) {
+            event.restored.point = point;
+            event.restored.changeSequence = info.changeSequence;
+        }
+    }
+    if (!changes.append(event) || !changes.sync() || !changes.publish()) {
+        store.discardStaged();
+        changes.discardFrom(first);
+        return fail("Unable to write change feed");
+    }
+    if (!store.commitStaged()) {
+        store.discardStaged();
+        return fail("Unable to replace database");
+    }
+
+    rebuildIndex();
+    resetSecondaryIndexes();
+    saveIndex();
+    dirty.markUnknown();
+    generationCount++;
+    clearError();
+    return true;
+}
+
+bool LibraryEngine::contains(int id) const {
+    auto reader = sharedAccess();
+    uint32_t slot;
+    return findSlot(id, slot);
+}
+
+size_t LibraryEngine::size() const {
+    auto reader = sharedAccess();
+    return recordCount;
+}
+
+int LibraryEngine::nextId() const {
+    auto reader = sharedAccess();
+    return maxId + 1;
+}
+
+uint64_t LibraryEngine::generation() const {
+    auto reader = sharedAccess();
+    return generationCount;
+}
+
+string LibraryEngine::lastError() const {
+    lock_guard<mutex> guard(errorLock);
+    return error;
+}
+
+/**
+ * Field validation applies the limits in BOOK_SCHEMA (book.h):
+ * - Title: 3-49 characters
+ * - Author: 2-29 letters and spaces
+ * - Price and quantity: within their schema range
+ */
+bool LibraryEngine::validateTitle(const string& title) {
+    return validBookText(BookField::title, title);
+}
+
+bool LibraryEngine::validateAuthor(const string& author) {
+    return validBookText(BookField::author, author);
+}
+
+bool LibraryEngine::validatePrice(float price) {
+    return validBookValue(BookField::price, price);
+}
+
+bool LibraryEngine::validateQuantity(int qty) {
+    return validBookValue(BookField::quantity, qty);
+}
+
+bool LibraryEngine::validateRecord(const Book& record) {
+    return validBook(record);
+}
+
+void LibraryEngine::setStatus(Book& record) {
+    safeStrCopy(record.status, record.quantity > 0 ? "Available" : "Out");
+}
+
+void LibraryEngine::removeFiles(const string& dataFile) {
+    string index = siblingFile(dataFile, ".idx");
+    vector<string> names = storeFiles(siblingFile(dataFile, ".hot"), siblingFile(dataFile, ".cold"));
+    names.insert(names.end(), { dataFile, index, index + ".tmp", siblingFile(dataFile, ".log"),
+                                siblingFile(dataFile, ".layout") });
+    for (const string& name : names) {
+        remove(name.c_str());
+    }
+
+    // Change feed segments are named after their first sequence, and
+    // the committed mark shares their prefix
+    string feed = siblingFile(dataFile, ".cdc") + ".";
+    size_t slash = feed.find_last_of('/');
+    string directory = slash == string::npos ? "." : feed.substr(0, slash);
+    string prefix = feed.substr(slash == string::npos ? 0 : slash + 1);
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0) {
+                remove((directory + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+    // Backup points and the dirty map live in a directory of their own
+    string backups = siblingFile(dataFile, ".backups");
+    if (DIR* dir = opendir(backups.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                remove((backups + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+        rmdir(backups.c_str());
+    }
+}
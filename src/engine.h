@@ -0,0 +1,220 @@
+/**
+ * Library Management System - Storage Engine
+ * Headless, programmatic access to the book database.
+ * Contains no console I/O so it can be embedded in other services
+ * or driven directly by benchmarks; LibrarySystem is a thin menu
+ * client on top of it.
+ *
+ * Thread safety: every public method may be called concurrently.
+ * checkout()/returnBook() share the engine and only lock the record
+ * they touch; all other mutations run exclusively.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "backup.h"
+#include "book.h"
+#include "changefeed.h"
+#include "fuzzy.h"
+#include "index.h"
+#include "journal.h"
+#include "range.h"
+#include "store.h"
+#include "topk.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Inclusive bounds for range queries; the defaults match everything
+struct RangeFilter {
+    float minPrice = 0.0f;
+    float maxPrice = MAX_PRICE;
+    int minQuantity = MIN_QUANTITY;
+    int maxQuantity = MAX_QUANTITY;
+};
+
+enum class CirculationStatus {
+    Ok,
+    NotFound,
+    OutOfStock,     // quantity already at MIN_QUANTITY
+    AtCapacity,     // quantity already at MAX_QUANTITY
+    IoError,        // nothing changed
+    NotDurable      // applied, but the journal could not confirm it; the
+                    // next checkpoint makes it durable, so do not retry
+};
+
+// Fields left empty keep their current value
+struct BookPatch {
+    optional<string> title;
+    optional<string> author;
+    optional<float> price;
+    optional<int> quantity;
+};
+
+class LibraryEngine {
+private:
+    static constexpr size_t RECORD_LOCKS = 256;
+
+    RecordStore store;                  // books.hot + books.cold
+    string hotFilename;
+    string indexFilename;
+    string journalFilename;
+    string dirtyFilename;
+    string error;
+    mutable mutex errorLock;            // error is set by writers and circulation alike
+
+    // Shared for lookups and circulation, exclusive for everything else
+    mutable shared_mutex stateLock;
+    mutable array<mutex, RECORD_LOCKS> recordLocks;  // striped by slot
+    mutable mutex secondaryLock;                     // range index updates from circulation
+    mutable Journal journal;                         // redo log for circulation
+    mutable ChangeFeed changes;                      // books.cdc.* event segments
+    mutable DirtyMap dirty;                          // slots written since the last backup
+    mutable BackupChain backupChain;                 // books.backups/
+
+    // Index state is loaded on first use, hence mutable
+    mutable IdIndex index;
+    mutable atomic<bool> indexLoaded;
+    mutable bool indexDirty;            // entries differ from books.idx
+    mutable atomic<bool> dataChanged;   // books.idx fingerprint is out of date
+    mutable size_t recordCount;
+    mutable int maxId;
+    mutable atomic<uint64_t> generationCount;
+
+    // Secondary indexes are built on first use and then kept current.
+    // They only change under the exclusive lock (quantityIndex also
+    // under secondaryLock, for circulation), so queries can share it
+    mutable TrigramIndex fuzzyIndex;
+    mutable atomic<bool> fuzzyLoaded;
+    mutable BucketIndex priceIndex;     // price in cents
+    mutable BucketIndex quantityIndex;
+    mutable atomic<bool> rangeLoaded;
+
+    // Rollback state of the write in progress
+    uint64_t writeStartSequence;                     // first change feed event
+    vector<pair<uint32_t, Book>> undoImages;         // overwritten records
+    size_t undoRecordCount;
+
+    // File operations
+    void ensureIndex() const;
+    void rebuildIndex() const;
+    void ensureFuzzyIndex() const;
+    void ensureRangeIndexes() const;
+    void resetSecondaryIndexes() const;
+    void renumberSecondary(const vector<uint32_t>& slotMap) const;
+    void indexSecondary(uint32_t slot, const Book& record) const;
+    void unindexSecondary(uint32_t slot, const Book& record) const;
+    bool saveIndex() const;
+    bool recoverJournal() const;
+    bool changeReachedStore(const ChangeEvent& event) const;
+    bool checkpointJournal() const;
+    shared_lock<shared_mutex> sharedAccess() const;
+    shared_lock<shared_mutex> sharedAccessBuilt(const atomic<bool>& loaded,
+                                                void (LibraryEngine::*build)() const) const;
+    unique_lock<shared_mutex> exclusiveAccess() const;
+    CirculationStatus adjustQuantity(int id, int delta);
+
+    // Commit helpers - every mutation is bracketed by begin/commit
+    bool beginWrite();
+    bool commitWrite();
+    bool finishWrite();
+    bool abortWrite(const string& reason);
+
+    bool findSlot(int id, uint32_t& slot) const;
+    bool readSlot(size_t slot, Book& out) const;
+    bool writeSlot(size_t slot, const Book& record);
+    bool rewriteWithout(const vector<int>& ids);
+    bool applyPatch(Book& record, const BookPatch& patch);
+    bool fail(const string& reason);
+    void clearError();
+
+public:
+    explicit LibraryEngine(const string& dataFile = "books.dat");
+    ~LibraryEngine();
+
+    LibraryEngine(const LibraryEngine&) = delete;
+    LibraryEngine& operator=(const LibraryEngine&) = delete;
+
+    // Single-record operations, each one is its own commit
+    bool get(int id, Book& out) const;
+    bool put(const Book& record);
+    bool update(int id, const BookPatch& patch);
+    bool erase(int id);
+
+    // Visits records in slot order; callback returns false to stop early.
+    // Records are read in chunks and no lock is held during callbacks.
+    // The engine lock is dropped between chunks, so a delete committed
+    // mid-scan shifts later slots down: records may then be skipped or
+    // visited twice. Callers that need one consistent view must not
+    // run concurrently with deletes.
+    void scan(const function<bool(const Book&)>& predicate,
+              const function<bool(const Book&)>& callback) const;
+
+    // Up to count records starting at slot first, in slot order, read
+    // directly rather than scanned for (paging). Returns how many.
+    size_t readRange(size_t first, size_t count, vector<Book>& out) const;
+
+    // Batch operations share a single backup and commit.
+    // Either every record is applied or none is.
+    size_t getBatch(const vector<int>& ids, vector<Book>& out) const;
+    bool putBatch(const vector<Book>& records);
+    bool updateBatch(const vector<pair<int, BookPatch>>& patches);
+    bool eraseBatch(const vector<int>& ids);
+
+    // Circulation: adjusts quantity by one in place and logs the change
+    // durably before returning. Safe and scalable across threads.
+    CirculationStatus checkout(int id);
+    CirculationStatus returnBook(int id);
+
+    // Typo-tolerant title/author search, best matches first
+    vector<FuzzyMatch> fuzzySearch(const string& query, size_t limit) const;
+
+    // Records inside every bound of the filter, in slot order;
+    // callback returns false to stop early. Returns records visited.
+    size_t rangeQuery(const RangeFilter& filter,
+                      const function<bool(const Book&)>& callback) const;
+    vector<Book> lowStock(int threshold = LOW_STOCK_THRESHOLD) const;
+
+    // The limit best records by key, best first, without sorting the
+    // catalog. threads = 0 uses one worker per hardware thread.
+    vector<Book> topK(RankKey key, bool highest, size_t limit, unsigned threads = 0) const;
+
+    // Incremental backups (backup.h); restore() replaces the live
+    // database and logs a Restore change event, restoreTo() writes
+    // the point to another file
+    bool backup(BackupInfo* created = nullptr);
+    vector<BackupInfo> backups() const;
+    bool restore(uint32_t point);
+    // target names the legacy data file; the columns are written
+    // next to it (restoreTo(p, "copy.dat") -> copy.hot, copy.cold).
+    // A target whose columns are the open database's is refused.
+    bool restoreTo(uint32_t point, const string& target);
+
+    bool contains(int id) const;
+    size_t size() const;
+    int nextId() const;
+    uint64_t generation() const;
+    string lastError() const;           // a copy; other threads may fail meanwhile
+
+    // Field validation shared with the menu interface
+    static bool validateTitle(const string& title);
+    static bool validateAuthor(const string& author);
+    static bool validatePrice(float price);
+    static bool validateQuantity(int qty);
+    static bool validateRecord(const Book& record);
+    static void setStatus(Book& record);
+
+    // Deletes a database that is not open: the data file and every file
+    // the engine keeps next to it (scratch catalogs of bench and replay)
+    static void removeFiles(const string& dataFile);
+};
+
+#endif
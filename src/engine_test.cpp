@@ -0,0 +1,870 @@
+/**
+ * Library Management System - Engine Unit Tests
+ *
+ * Usage: library-tests [name filter]
+ *
+ * Every test opens a LibraryEngine on a fresh temporary directory, so
+ * tests never see each other's files or the real books.dat. A failed
+ * check prints its location and the test carries on; the exit status
+ * is the number of failed tests.
+ */
+
+#include "engine.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    struct TestCase {
+        const char* name;
+        void (*run)(const string& dir);
+    };
+
+    vector<TestCase>& registry() {
+        static vector<TestCase> tests;
+        return tests;
+    }
+
+    struct Registrar {
+        Registrar(const char* name, void (*run)(const string&)) {
+            registry().push_back({ name, run });
+        }
+    };
+
+    int failedChecks = 0;
+
+    void check(bool ok, const char* expression, const char* file, int line) {
+        if (!ok) {
+            cerr << "  " << file << ":" << line << ": CHECK(" << expression << ") failed" << endl;
+            failedChecks++;
+        }
+    }
+
+    #define CHECK(expression) check((expression), #expression, __FILE__, __LINE__)
+    #define TEST(name) \
+        void name(const string& dir); \
+        Registrar name##Registrar(#name, name); \
+        void name(const string& dir)
+
+    void removeTree(const string& path) {
+        if (DIR* dir = opendir(path.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                string name = entry->d_name;
+                if (name == "." || name == "..") continue;
+                string child = path + "/" + name;
+                struct stat info;
+                if (lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+                    removeTree(child);
+                } else {
+                    unlink(child.c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(path.c_str());
+    }
+
+    // Lowest accepted value of a field: text gets `low` letters
+    template <FieldKind Kind, typename T>
+    void setLowest(T& field, double low) {
+        field = static_cast<T>(low);
+    }
+
+    template <FieldKind Kind, size_t N>
+    void setLowest(char (&field)[N], double low) {
+        size_t length = min(static_cast<size_t>(low), N - 1);
+        memset(field, 'A', length);
+        field[length] = '\0';
+    }
+
+    #define TEST_FIELD_LOWEST(file, kind, name, label, size, width, low, high) \
+        setLowest<FieldKind::kind>(record.name, low);
+
+    // Every field starts valid, so the suite also runs on builds with
+    // extra schema fields (library-schema-tests)
+    Book makeBook(int id, const string& title = "", int quantity = 5) {
+        Book record = {};
+        BOOK_SCHEMA(TEST_FIELD_LOWEST)
+        record.id = id;
+        safeStrCopy(record.title, title.empty() ? "Test Title " + to_string(id) : title);
+        safeStrCopy(record.author, "Test Author");
+        record.price = 10.0f + id % 100;
+        record.quantity = quantity;
+        return record;
+    }
+
+    vector<Book> makeBooks(int first, int last) {
+        vector<Book> records;
+        for (int id = first; id <= last; id++) {
+            records.push_back(makeBook(id));
+        }
+        return records;
+    }
+
+    vector<int> scanIds(const LibraryEngine& engine) {
+        vector<int> ids;
+        engine.scan(nullptr, [&](const Book& record) {
+            ids.push_back(record.id);
+            return true;
+        });
+        return ids;
+    }
+
+    string dataFile(const string& dir) {
+        return dir + "/books.dat";
+    }
+
+    string feedBase(const string& dir) {
+        return dir + "/books.cdc";
+    }
+
+    // Everything a feed reader can see right now
+    vector<ChangeEvent> publishedChanges(const string& dir) {
+        vector<ChangeEvent> events;
+        uint64_t firstAvailable;
+        readChanges(feedBase(dir), 1, 1000, events, firstAvailable);
+        return events;
+    }
+}
+
+TEST(putAndGet) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.size() == 0);
+    CHECK(engine.nextId() == 1);
+
+    CHECK(engine.put(makeBook(7, "Dune")));
+    Book found;
+    CHECK(engine.get(7, found));
+    CHECK(found.id == 7);
+    CHECK(string(found.title) == "Dune");
+    CHECK(string(found.status) == "Available");
+    CHECK(engine.contains(7));
+    CHECK(!engine.get(8, found));
+    CHECK(engine.size() == 1);
+    CHECK(engine.nextId() == 8);
+}
+
+TEST(updatePatchesOnlyGivenFields) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.put(makeBook(1, "Old Title", 4)));
+
+    BookPatch patch;
+    patch.title = "New Title";
+    patch.quantity = 0;
+    CHECK(engine.update(1, patch));
+
+    Book found;
+    CHECK(engine.get(1, found));
+    CHECK(string(found.title) == "New Title");
+    CHECK(string(found.author) == "Test Author");
+    CHECK(found.quantity == 0);
+    CHECK(string(found.status) == "Out");
+}
+
+TEST(eraseKeepsOrderOfSurvivors) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 6)));
+    CHECK(engine.erase(3));
+    CHECK(!engine.contains(3));
+    CHECK(engine.size() == 5);
+    CHECK(scanIds(engine) == vector<int>({ 1, 2, 4, 5, 6 }));
+
+    Book found;
+    CHECK(engine.get(6, found));
+    CHECK(string(found.title) == "Test Title 6");
+}
+
+TEST(scanFiltersAndStopsEarly) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 10000)));
+
+    size_t even = 0;
+    engine.scan([](const Book& record) { return record.id % 2 == 0; },
+                [&](const Book& record) {
+                    CHECK(record.id % 2 == 0);
+                    even++;
+                    return true;
+                });
+    CHECK(even == 5000);
+
+    size_t visited = 0;
+    engine.scan(nullptr, [&](const Book&) { return ++visited < 3; });
+    CHECK(visited == 3);
+}
+
+TEST(readRangeReadsOnePage) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 12)));
+    CHECK(engine.erase(2));
+
+    vector<Book> page;
+    CHECK(engine.readRange(5, RECORDS_PER_PAGE, page) == 5);
+    CHECK(page.front().id == 7 && page.back().id == 11);
+    CHECK(engine.readRange(10, RECORDS_PER_PAGE, page) == 1);
+    CHECK(page[0].id == 12);
+    CHECK(engine.readRange(11, RECORDS_PER_PAGE, page) == 0);
+    CHECK(page.empty());
+}
+
+TEST(duplicateAndInvalidIdsAreRejected) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.put(makeBook(1)));
+    CHECK(!engine.put(makeBook(1)));
+    CHECK(!engine.lastError().empty());
+    CHECK(!engine.put(makeBook(0)));
+    CHECK(!engine.put(makeBook(-5)));
+
+    Book invalid = makeBook(2);
+    invalid.quantity = MAX_QUANTITY + 1;
+    CHECK(!engine.put(invalid));
+    safeStrCopy(invalid.title, "ab");
+    invalid.quantity = 1;
+    CHECK(!engine.put(invalid));
+
+    CHECK(!engine.update(99, BookPatch()));
+    CHECK(!engine.erase(99));
+    CHECK(engine.size() == 1);
+}
+
+TEST(putBatchIsAllOrNothing) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 3)));
+
+    // Duplicate inside the batch
+    vector<Book> batch = makeBooks(10, 12);
+    batch.push_back(makeBook(11));
+    CHECK(!engine.putBatch(batch));
+
+    // Clash with a stored id
+    batch = makeBooks(10, 12);
+    batch.push_back(makeBook(2));
+    CHECK(!engine.putBatch(batch));
+
+    // One invalid record
+    batch = makeBooks(10, 12);
+    batch[1].price = -1.0f;
+    CHECK(!engine.putBatch(batch));
+
+    CHECK(engine.size() == 3);
+    CHECK(!engine.contains(10));
+    CHECK(scanIds(engine) == vector<int>({ 1, 2, 3 }));
+}
+
+TEST(updateBatchIsAllOrNothing) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 3)));
+
+    BookPatch quantity;
+    quantity.quantity = 9;
+    BookPatch badPrice;
+    badPrice.price = MAX_PRICE * 2;
+
+    CHECK(!engine.updateBatch({ { 1, quantity }, { 4, quantity } }));
+    CHECK(!engine.updateBatch({ { 1, quantity }, { 2, badPrice } }));
+
+    Book found;
+    CHECK(engine.get(1, found) && found.quantity == 5);
+    CHECK(engine.get(2, found) && found.price == 12.0f);
+
+    // Later patches to the same id build on earlier ones
+    BookPatch title;
+    title.title = "Renamed";
+    CHECK(engine.updateBatch({ { 1, quantity }, { 1, title } }));
+    CHECK(engine.get(1, found));
+    CHECK(found.quantity == 9);
+    CHECK(string(found.title) == "Renamed");
+}
+
+TEST(eraseBatchIsAllOrNothing) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 5)));
+
+    CHECK(!engine.eraseBatch({ 2, 4, 42 }));
+    CHECK(engine.size() == 5);
+    CHECK(engine.contains(2) && engine.contains(4));
+
+    CHECK(engine.eraseBatch({ 2, 4 }));
+    CHECK(scanIds(engine) == vector<int>({ 1, 3, 5 }));
+}
+
+TEST(batchReadSkipsMissingIds) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 5)));
+
+    vector<Book> found;
+    CHECK(engine.getBatch({ 5, 9, 1 }, found) == 2);
+    CHECK(found.size() == 2);
+    CHECK(found[0].id == 5 && found[1].id == 1);
+}
+
+TEST(reopenKeepsRecordsAndIndex) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.putBatch(makeBooks(1, 100)));
+        CHECK(engine.erase(50));
+        BookPatch patch;
+        patch.author = "Someone Else";
+        CHECK(engine.update(60, patch));
+        CHECK(engine.checkout(70) == CirculationStatus::Ok);
+    }
+
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.size() == 99);
+    CHECK(engine.nextId() == 101);
+    CHECK(!engine.contains(50));
+
+    Book found;
+    CHECK(engine.get(60, found) && string(found.author) == "Someone Else");
+    CHECK(engine.get(70, found) && found.quantity == 4);
+    CHECK(engine.put(makeBook(101)));
+}
+
+TEST(circulationStopsAtLimits) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.put(makeBook(1, "", MIN_QUANTITY + 1)));
+
+    CHECK(engine.checkout(1) == CirculationStatus::Ok);
+    CHECK(engine.checkout(1) == CirculationStatus::OutOfStock);
+    CHECK(engine.checkout(2) == CirculationStatus::NotFound);
+
+    Book found;
+    CHECK(engine.get(1, found) && string(found.status) == "Out");
+    CHECK(engine.returnBook(1) == CirculationStatus::Ok);
+    CHECK(engine.get(1, found) && string(found.status) == "Available");
+}
+
+TEST(fuzzySearchForgivesTypos) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch({ makeBook(1, "The Pragmatic Programmer"), makeBook(2, "Clean Code"),
+                            makeBook(3, "Refactoring") }));
+
+    vector<FuzzyMatch> matches = engine.fuzzySearch("pragmatc programer", FUZZY_RESULTS);
+    CHECK(!matches.empty() && matches[0].book.id == 1);
+    CHECK(engine.fuzzySearch("Clean Code", FUZZY_RESULTS)[0].distance == 0);
+    CHECK(engine.fuzzySearch("zzzzzzzz", FUZZY_RESULTS).empty());
+}
+
+TEST(fuzzySearchRunsBesideCirculation) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 2000)));
+
+    // Searches and checkouts interleave; neither may see a torn record
+    vector<thread> workers;
+    int wrongMatches = 0;
+    int failedCheckouts = 0;
+    workers.emplace_back([&]() {
+        for (int i = 0; i < 200; i++) {
+            vector<FuzzyMatch> matches = engine.fuzzySearch("Test Title 1234", 1);
+            if (matches.empty() || matches[0].book.id != 1234) wrongMatches++;
+        }
+    });
+    workers.emplace_back([&]() {
+        for (int id = 1; id <= 500; id++) {
+            if (engine.checkout(id) != CirculationStatus::Ok) failedCheckouts++;
+        }
+    });
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    CHECK(wrongMatches == 0);
+    CHECK(failedCheckouts == 0);
+}
+
+TEST(rangeQueriesFollowCirculation) {
+    LibraryEngine engine(dataFile(dir));
+    vector<Book> records = makeBooks(1, 300);
+    for (Book& record : records) {
+        record.quantity = record.id % 10;
+    }
+    CHECK(engine.putBatch(records));
+
+    CHECK(engine.lowStock(0).size() == 30);
+    CHECK(engine.checkout(11) == CirculationStatus::Ok);
+    CHECK(engine.lowStock(0).size() == 31);
+
+    RangeFilter filter;
+    filter.minPrice = 20.0f;
+    filter.maxPrice = 29.99f;
+    filter.minQuantity = 5;
+    size_t matched = engine.rangeQuery(filter, [&](const Book& record) {
+        CHECK(record.price >= 20.0f && record.price <= 29.99f && record.quantity >= 5);
+        return true;
+    });
+    CHECK(matched == 15);
+
+    // Lookups keep running while a report holds its matches
+    int extra = 0;
+    thread circulation([&]() {
+        for (int id = 100; id < 200; id++) {
+            extra += engine.checkout(id) == CirculationStatus::Ok;
+        }
+    });
+    for (int i = 0; i < 20; i++) {
+        for (const Book& record : engine.lowStock(LOW_STOCK_THRESHOLD)) {
+            CHECK(record.quantity <= LOW_STOCK_THRESHOLD);
+        }
+    }
+    circulation.join();
+    CHECK(extra == 90);
+}
+
+TEST(secondaryIndexesFollowDeletes) {
+    LibraryEngine engine(dataFile(dir));
+    vector<Book> records = makeBooks(1, 50);
+    for (Book& record : records) {
+        record.quantity = record.id % 2 ? 1 : 20;
+    }
+    CHECK(engine.putBatch(records));
+
+    // Load both indexes, then shift every slot after the first delete
+    CHECK(engine.lowStock(1).size() == 25);
+    CHECK(engine.fuzzySearch("Test Title 42", 1)[0].book.id == 42);
+    CHECK(engine.eraseBatch({ 3, 10, 11 }));
+    CHECK(engine.put(makeBook(51, "Late Arrival", 0)));
+
+    vector<Book> low = engine.lowStock(1);
+    CHECK(low.size() == 24);
+    for (const Book& record : low) {
+        CHECK(record.id % 2 == 1 || record.id == 51);
+        CHECK(record.id != 3 && record.id != 11);
+    }
+    CHECK(engine.fuzzySearch("Test Title 42", 1)[0].book.id == 42);
+    CHECK(engine.fuzzySearch("Late Arival", 1)[0].book.id == 51);
+    vector<FuzzyMatch> gone = engine.fuzzySearch("Test Title 10", FUZZY_RESULTS);
+    for (const FuzzyMatch& match : gone) {
+        CHECK(match.book.id != 10);
+    }
+}
+
+TEST(lastErrorIsSafeBesideFailingWrites) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.put(makeBook(1)));
+
+    thread writer([&]() {
+        for (int i = 0; i < 200; i++) {
+            engine.put(makeBook(1));
+            engine.put(makeBook(1000 + i));
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        string copy = engine.lastError();
+        CHECK(copy.empty() || copy.find("Duplicate") == 0);
+    }
+    writer.join();
+    CHECK(engine.size() == 201);
+
+    CHECK(!engine.put(makeBook(1)));
+    string failure = engine.lastError();
+    CHECK(engine.put(makeBook(2)));
+    CHECK(engine.lastError().empty());
+    CHECK(!failure.empty());
+}
+
+TEST(feedHidesUnpublishedEvents) {
+    ChangeFeed feed;
+    CHECK(feed.open(feedBase(dir)));
+    Book record = makeBook(1);
+    CHECK(feed.append(ChangeType::Insert, nullptr, &record) == 1);
+    CHECK(publishedChanges(dir).empty());
+
+    CHECK(feed.sync() && feed.publish());
+    CHECK(publishedChanges(dir).size() == 1);
+
+    // Out-of-order confirmations wait for the ones before them
+    uint64_t second = feed.append(ChangeType::Update, &record, &record);
+    uint64_t third = feed.append(ChangeType::Update, &record, &record);
+    feed.publish(third);
+    CHECK(publishedChanges(dir).size() == 1);
+    feed.publish(second);
+    CHECK(publishedChanges(dir).size() == 3);
+}
+
+TEST(discardedSequencesAreNeverReused) {
+    ChangeFeed feed(4);
+    CHECK(feed.open(feedBase(dir)));
+    Book record = makeBook(1);
+    feed.append(ChangeType::Insert, nullptr, &record);
+    CHECK(feed.sync() && feed.publish());
+    for (int i = 0; i < 5; i++) {
+        feed.append(ChangeType::Update, &record, &record);
+    }
+    CHECK(feed.discardFrom(2));
+    CHECK(feed.nextSequence() == 7);
+    CHECK(feed.append(ChangeType::Delete, &record, nullptr) == 7);
+    CHECK(feed.sync() && feed.publish());
+
+    vector<ChangeEvent> events = publishedChanges(dir);
+    CHECK(events.size() == 2);
+    CHECK(events.size() == 2 && events[0].sequence == 1 && events[1].sequence == 7);
+}
+
+TEST(unpublishedWriteIsDiscardedOnReopen) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.put(makeBook(1)));
+    }
+    // What a crash in the middle of an update leaves behind
+    {
+        ChangeFeed feed;
+        CHECK(feed.open(feedBase(dir)));
+        Book before = makeBook(1);
+        Book after = makeBook(1, "Never Written");
+        CHECK(feed.append(ChangeType::Update, &before, &after) == 2);
+    }
+    CHECK(publishedChanges(dir).size() == 1);
+
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.put(makeBook(2)));
+    vector<ChangeEvent> events = publishedChanges(dir);
+    CHECK(events.size() == 2);
+    CHECK(events.size() == 2 && events[1].sequence == 3 && events[1].after.id == 2);
+}
+
+TEST(lostCheckoutEventIsRebuiltFromJournal) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.put(makeBook(1)));
+    }
+
+    // The child checks out, loses the unsynced feed event and dies
+    // without closing anything
+    pid_t child = fork();
+    if (child == 0) {
+        LibraryEngine engine(dataFile(dir));
+        bool ok = engine.checkout(1) == CirculationStatus::Ok;
+        ok = ok && truncate((feedBase(dir) + ".00000000000000000001").c_str(), sizeof(ChangeEvent)) == 0;
+        _exit(ok ? 0 : 1);
+    }
+    int status = -1;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(publishedChanges(dir).size() == 1);
+
+    LibraryEngine engine(dataFile(dir));
+    Book record;
+    CHECK(engine.get(1, record) && record.quantity == 4);
+    vector<ChangeEvent> events = publishedChanges(dir);
+    CHECK(events.size() == 2);
+    if (events.size() == 2) {
+        CHECK(events[1].sequence == 2);
+        CHECK(events[1].type == static_cast<uint32_t>(ChangeType::Update));
+        CHECK(events[1].before.quantity == 5 && events[1].after.quantity == 4);
+        CHECK(events[1].timeNs >= events[0].timeNs);
+    }
+}
+
+TEST(otherLayoutIsRefused) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.put(makeBook(1)));
+    }
+    LayoutStamp stamp;
+    CHECK(readLayout(dir + "/books.layout", stamp) && stamp.layout == BOOK_LAYOUT);
+
+    // A stamp from another schema
+    stamp.layout ^= 1;
+    stamp.checksum = fnv1a(&stamp, offsetof(LayoutStamp, checksum));
+    FILE* file = fopen((dir + "/books.layout").c_str(), "wb");
+    CHECK(file && fwrite(&stamp, sizeof(stamp), 1, file) == 1);
+    if (file) fclose(file);
+    bool refused = false;
+    try {
+        LibraryEngine engine(dataFile(dir));
+    } catch (const runtime_error&) {
+        refused = true;
+    }
+    CHECK(refused);
+
+    // A feed segment whose events carry another layout is not cut back
+    CHECK(writeLayout(dir + "/books.layout"));
+    string segment = feedBase(dir) + ".00000000000000000001";
+    struct stat before;
+    CHECK(stat(segment.c_str(), &before) == 0 && before.st_size == sizeof(ChangeEvent));
+    file = fopen(segment.c_str(), "r+b");
+    uint32_t foreign = 0x12345678;
+    CHECK(file && fwrite(&foreign, sizeof(foreign), 1, file) == 1);
+    if (file) fclose(file);
+    ChangeFeed feed;
+    CHECK(!feed.open(feedBase(dir)));
+    struct stat after;
+    CHECK(stat(segment.c_str(), &after) == 0 && after.st_size == before.st_size);
+}
+
+TEST(restoreIsAnnouncedOnTheFeed) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 3)));
+    BackupInfo info;
+    CHECK(engine.backup(&info));
+    CHECK(engine.erase(2));
+    CHECK(engine.put(makeBook(4)));
+
+    CHECK(engine.restore(info.point));
+    CHECK(scanIds(engine) == vector<int>({ 1, 2, 3 }));
+
+    vector<ChangeEvent> events = publishedChanges(dir);
+    CHECK(events.size() == 6);
+    if (events.size() == 6) {
+        const ChangeEvent& marker = events.back();
+        CHECK(marker.type == static_cast<uint32_t>(ChangeType::Restore));
+        CHECK(marker.restored.point == info.point);
+        CHECK(marker.restored.changeSequence == info.changeSequence);
+        CHECK(info.changeSequence == 4);
+        CHECK(formatChange(marker).find("\"op\":\"restore\",") != string::npos);
+    }
+}
+
+TEST(restoreToRefusesTheOpenDatabase) {
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 3)));
+    BackupInfo info;
+    CHECK(engine.backup(&info));
+    CHECK(engine.put(makeBook(4)));
+
+    CHECK(!engine.restoreTo(info.point, dataFile(dir)));
+    CHECK(!engine.restoreTo(info.point, dir + "/./books.hot"));
+    CHECK(engine.lastError().find("open database") != string::npos);
+    CHECK(scanIds(engine) == vector<int>({ 1, 2, 3, 4 }));
+
+    CHECK(engine.restoreTo(info.point, dir + "/copy.dat"));
+    LibraryEngine copy(dir + "/copy.dat");
+    CHECK(scanIds(copy) == vector<int>({ 1, 2, 3 }));
+}
+
+TEST(deltaChainRestoresByteIdentical) {
+    auto fileBytes = [](const string& path) {
+        string bytes;
+        FILE* file = fopen(path.c_str(), "rb");
+        char buffer[4096];
+        size_t got;
+        while (file && (got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.append(buffer, got);
+        }
+        if (file) fclose(file);
+        return bytes;
+    };
+
+    LibraryEngine engine(dataFile(dir));
+    CHECK(engine.putBatch(makeBooks(1, 100)));
+    vector<pair<BackupInfo, string>> points;
+    auto takeBackup = [&]() {
+        BackupInfo info;
+        CHECK(engine.backup(&info));
+        points.push_back({ info, fileBytes(dir + "/books.hot") + fileBytes(dir + "/books.cold") });
+    };
+    takeBackup();
+
+    BookPatch patch;
+    patch.price = 12.5f;
+    patch.author = "Revised";
+    CHECK(engine.update(7, patch) && engine.update(40, patch));
+    CHECK(engine.checkout(3) == CirculationStatus::Ok);
+    CHECK(engine.checkout(60) == CirculationStatus::Ok);
+    takeBackup();
+
+    // A delete near the end keeps the next backup a delta
+    CHECK(engine.erase(95));
+    CHECK(engine.returnBook(3) == CirculationStatus::Ok);
+    takeBackup();
+
+    CHECK(engine.update(96, patch));
+    CHECK(engine.erase(98));
+    CHECK(engine.checkout(99) == CirculationStatus::Ok);
+    CHECK(engine.put(makeBook(101)));
+    takeBackup();
+
+    CHECK(points.size() == 4 && points[0].first.full == 1);
+    for (size_t i = 1; i < points.size(); i++) {
+        CHECK(points[i].first.full == 0);
+    }
+    for (const auto& point : points) {
+        string copy = dir + "/copy" + to_string(point.first.point);
+        CHECK(engine.restoreTo(point.first.point, copy + ".dat"));
+        CHECK(fileBytes(copy + ".hot") + fileBytes(copy + ".cold") == point.second);
+    }
+}
+
+TEST(journalRecoversAfterCheckpoint) {
+    Journal journal;
+    CHECK(journal.open(dir + "/books.log"));
+    char entry[64] = {};
+
+    // Writes past the file size limit fail, as on a full disk
+    struct rlimit saved;
+    CHECK(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+    struct rlimit limited = saved;
+    limited.rlim_cur = sizeof(entry) + sizeof(entry) / 2;
+    void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+    CHECK(setrlimit(RLIMIT_FSIZE, &limited) == 0);
+    CHECK(journal.waitDurable(journal.append(entry, sizeof(entry))));
+    CHECK(!journal.waitDurable(journal.append(entry, sizeof(entry))));
+    CHECK(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+    signal(SIGXFSZ, previous);
+
+    CHECK(journal.hasFailed());
+    CHECK(!journal.waitDurable(journal.append(entry, sizeof(entry))));
+    CHECK(journal.truncate());
+    CHECK(!journal.hasFailed());
+    CHECK(journal.waitDurable(journal.append(entry, sizeof(entry))));
+    CHECK(journal.size() == sizeof(entry));
+}
+
+TEST(removeFilesLeavesNothingBehind) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.putBatch(makeBooks(1, 5)));
+        CHECK(engine.backup());
+        CHECK(engine.checkout(2) == CirculationStatus::Ok);
+        CHECK(engine.erase(3));
+        CHECK(engine.backup());
+    }
+    LibraryEngine::removeFiles(dataFile(dir));
+
+    vector<string> left;
+    if (DIR* listing = opendir(dir.c_str())) {
+        while (dirent* entry = readdir(listing)) {
+            if (entry->d_name[0] != '.') left.push_back(entry->d_name);
+        }
+        closedir(listing);
+    }
+    CHECK(left.empty());
+}
+
+TEST(topKMatchesStableSort) {
+    // Few distinct prices and quantities, so every key has ties; ids go
+    // in out of order so slot order is no hint
+    auto catalog = [](int books) {
+        vector<Book> records;
+        records.reserve(books);
+        for (int i = 0; i < books; i++) {
+            int id = static_cast<int>(static_cast<int64_t>(i) * 7919 % books) + 1;
+            Book record = makeBook(id);
+            record.price = 1.5f + static_cast<float>(id * 31 % 5) / 2;
+            record.quantity = id * 7 % 4;
+            records.push_back(record);
+        }
+        return records;
+    };
+    auto matchesSort = [](const LibraryEngine& engine, vector<Book> records, const vector<size_t>& limits) {
+        sort(records.begin(), records.end(), [](const Book& a, const Book& b) { return a.id < b.id; });
+        bool same = true;
+        for (RankKey key : { RankKey::Price, RankKey::Quantity, RankKey::Value }) {
+            auto value = [key](const Book& record) {
+                return key == RankKey::Price ? record.price :
+                       key == RankKey::Quantity ? record.quantity :
+                       static_cast<double>(record.price) * record.quantity;
+            };
+            for (bool highest : { true, false }) {
+                // Ties keep id order, which is the lower id first
+                vector<Book> expected = records;
+                stable_sort(expected.begin(), expected.end(), [&](const Book& a, const Book& b) {
+                    return highest ? value(a) > value(b) : value(a) < value(b);
+                });
+                for (size_t limit : limits) {
+                    for (unsigned threads : { 1u, 4u }) {
+                        vector<Book> top = engine.topK(key, highest, limit, threads);
+                        same = same && top.size() == min(limit, expected.size());
+                        for (size_t i = 0; same && i < top.size(); i++) {
+                            same = top[i].id == expected[i].id;
+                        }
+                    }
+                }
+            }
+        }
+        return same;
+    };
+
+    vector<Book> small = catalog(40);
+    LibraryEngine smallEngine(dir + "/small.dat");
+    CHECK(smallEngine.putBatch(small));
+    CHECK(matchesSort(smallEngine, small, { 1, 7, 40, 100 }));
+
+    // Two 2^18-record slices, so four threads really split the catalog
+    vector<Book> large = catalog(2 * (1 << 18) + 1001);
+    LibraryEngine largeEngine(dataFile(dir));
+    CHECK(largeEngine.putBatch(large));
+    CHECK(matchesSort(largeEngine, large, { 1, 100 }));
+}
+
+TEST(shortColdFileIsRefusedNotTrimmed) {
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.putBatch(makeBooks(1, 10)));
+    }
+    string hot = dir + "/books.hot";
+    string cold = dir + "/books.cold";
+    auto fileSize = [](const string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? static_cast<long long>(info.st_size) : -1LL;
+    };
+
+    // An interrupted append: a cold record and half a hot one
+    CHECK(truncate(cold.c_str(), 11 * sizeof(ColdRecord)) == 0);
+    CHECK(truncate(hot.c_str(), 10 * sizeof(HotRecord) + sizeof(HotRecord) / 2) == 0);
+    {
+        LibraryEngine engine(dataFile(dir));
+        CHECK(engine.size() == 10);
+    }
+    CHECK(fileSize(hot) == 10 * static_cast<long long>(sizeof(HotRecord)));
+    CHECK(fileSize(cold) == 10 * static_cast<long long>(sizeof(ColdRecord)));
+
+    // Hot records without their cold half are damage: refused, left alone
+    for (long long coldSize : { 9LL * static_cast<long long>(sizeof(ColdRecord)), -1LL }) {
+        if (coldSize < 0) {
+            CHECK(unlink(cold.c_str()) == 0);
+        } else {
+            CHECK(truncate(cold.c_str(), coldSize) == 0);
+        }
+        bool refused = false;
+        try {
+            LibraryEngine engine(dataFile(dir));
+            engine.size();
+        } catch (const runtime_error&) {
+            refused = true;
+        }
+        CHECK(refused);
+        CHECK(fileSize(hot) == 10 * static_cast<long long>(sizeof(HotRecord)));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string filter = argc > 1 ? argv[1] : "";
+    int failedTests = 0;
+    int ran = 0;
+
+    for (const TestCase& test : registry()) {
+        if (!filter.empty() && string(test.name).find(filter) == string::npos) continue;
+
+        char pattern[] = "/tmp/library-test-XXXXXX";
+        if (!mkdtemp(pattern)) {
+            cerr << "Unable to create a temporary directory" << endl;
+            return 1;
+        }
+
+        int before = failedChecks;
+        try {
+            test.run(pattern);
+        } catch (const exception& e) {
+            cerr << "  unexpected exception: " << e.what() << endl;
+            failedChecks++;
+        }
+        removeTree(pattern);
+
+        bool passed = failedChecks == before;
+        cout << (passed ? "[ OK ] " : "[FAIL] ") << test.name << endl;
+        failedTests += !passed;
+        ran++;
+    }
+
+    cout << ran - failedTests << " of " << ran << " tests passed" << endl;
+    return failedTests;
+}
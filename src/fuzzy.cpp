@@ -0,0 +1,191 @@
+/**
+ * Library Management System - Fuzzy Title Search Implementation
+ *
+ * Key points:
+ *   - Titles and authors are normalised (lowercase, punctuation as
+ *     spaces) before trigrams are taken, so "C++" and "c" match
+ *   - Posting lists hold record slots in ascending order, which keeps
+ *     appends cheap and lets updates binary search their entry
+ *   - Each edit can destroy at most three trigrams, which bounds how
+ *     many a real match may lose and gives the candidate threshold
+ */
+
+#include "fuzzy.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+    uint32_t packTrigram(unsigned char a, unsigned char b, unsigned char c) {
+        return (uint32_t(a) << 16) | (uint32_t(b) << 8) | c;
+    }
+}
+
+string normaliseText(const string& text) {
+    string out;
+    out.reserve(text.size());
+    for (unsigned char c : text) {
+        if (c == '\0') break;
+        if (isalnum(c)) {
+            out += static_cast<char>(tolower(c));
+        } else if (!out.empty() && out.back() != ' ') {
+            out += ' ';
+        }
+    }
+    if (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+    return out;
+}
+
+void textTrigrams(const string& normalised, vector<uint32_t>& out) {
+    if (normalised.empty()) return;
+
+    string padded = " " + normalised + " ";
+    for (size_t i = 0; i + 2 < padded.size(); i++) {
+        out.push_back(packTrigram(padded[i], padded[i + 1], padded[i + 2]));
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+/**
+ * Myers' bit-vector algorithm in its search form: the top row of the
+ * DP matrix stays zero so a match may start anywhere in the text.
+ * One word of state per text character, no matrix is allocated.
+ */
+int substringEditDistance(const string& pattern, const string& text) {
+    size_t m = min<size_t>(pattern.size(), 64);
+    if (m == 0) return 0;
+
+    uint64_t peq[256] = {};
+    for (size_t i = 0; i < m; i++) {
+        peq[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+    }
+
+    uint64_t pv = ~uint64_t(0);
+    uint64_t mv = 0;
+    uint64_t high = uint64_t(1) << (m - 1);
+    int score = static_cast<int>(m);
+    int best = score;
+
+    for (unsigned char c : text) {
+        uint64_t eq = peq[c];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if (ph & high) score++;
+        else if (mh & high) score--;
+
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        best = min(best, score);
+        if (best == 0) break;
+    }
+    return best;
+}
+
+void TrigramIndex::documentTrigrams(const Book& record, vector<uint32_t>& out) {
+    string title(record.title, strnlen(record.title, MAX_TITLE_LENGTH));
+    string author(record.author, strnlen(record.author, MAX_AUTHOR_LENGTH));
+    textTrigrams(normaliseText(title) + " " + normaliseText(author), out);
+}
+
+void TrigramIndex::clear() {
+    postings.clear();
+}
+
+void TrigramIndex::add(uint32_t slot, const Book& record) {
+    vector<uint32_t> grams;
+    documentTrigrams(record, grams);
+    for (uint32_t gram : grams) {
+        vector<uint32_t>& list = postings[gram];
+        if (list.empty() || list.back() < slot) {
+            list.push_back(slot);
+        } else {
+            auto it = lower_bound(list.begin(), list.end(), slot);
+            if (it == list.end() || *it != slot) {
+                list.insert(it, slot);
+            }
+        }
+    }
+}
+
+void TrigramIndex::remove(uint32_t slot, const Book& record) {
+    vector<uint32_t> grams;
+    documentTrigrams(record, grams);
+    for (uint32_t gram : grams) {
+        auto found = postings.find(gram);
+        if (found == postings.end()) continue;
+        vector<uint32_t>& list = found->second;
+        auto it = lower_bound(list.begin(), list.end(), slot);
+        if (it != list.end() && *it == slot) {
+            list.erase(it);
+        }
+        if (list.empty()) {
+            postings.erase(found);
+        }
+    }
+}
+
+// The map only ever moves slots down, so posting lists stay sorted
+void TrigramIndex::renumber(const vector<uint32_t>& slotMap) {
+    for (auto it = postings.begin(); it != postings.end();) {
+        vector<uint32_t>& list = it->second;
+        size_t kept = 0;
+        for (uint32_t slot : list) {
+            uint32_t moved = slot < slotMap.size() ? slotMap[slot] : UINT32_MAX;
+            if (moved != UINT32_MAX) {
+                list[kept++] = moved;
+            }
+        }
+        list.resize(kept);
+        it = list.empty() ? postings.erase(it) : next(it);
+    }
+}
+
+vector<pair<uint32_t, int>> TrigramIndex::candidates(const vector<uint32_t>& query,
+                                                     int minShared, size_t limit) const {
+    // Per-query shared-trigram counts, indexed by slot
+    vector<uint16_t> counts;
+    vector<uint32_t> touched;
+    for (uint32_t gram : query) {
+        auto found = postings.find(gram);
+        if (found == postings.end()) continue;
+        for (uint32_t slot : found->second) {
+            if (slot >= counts.size()) {
+                counts.resize(slot + 1, 0);
+            }
+            if (counts[slot]++ == 0) {
+                touched.push_back(slot);
+            }
+        }
+    }
+
+    vector<pair<uint32_t, int>> result;
+    for (uint32_t slot : touched) {
+        if (counts[slot] >= minShared) {
+            result.emplace_back(slot, counts[slot]);
+        }
+    }
+
+    auto better = [](const pair<uint32_t, int>& a, const pair<uint32_t, int>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    };
+    if (result.size() > limit) {
+        partial_sort(result.begin(), result.begin() + limit, result.end(), better);
+        result.resize(limit);
+    } else {
+        sort(result.begin(), result.end(), better);
+    }
+    return result;
+}
+
+size_t TrigramIndex::trigramCount() const {
+    return postings.size();
+}
@@ -0,0 +1,58 @@
+/**
+ * Library Management System - Fuzzy Title Search
+ * Typo-tolerant lookup over Book::title and Book::author.
+ *
+ * A trigram index narrows the catalog to records that share enough
+ * three-letter fragments with the query; only those candidates are
+ * ranked with a bit-parallel (Myers) edit distance.
+ */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include "book.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct FuzzyMatch {
+    Book book;
+    int distance;   // edits needed to find the query in title or author
+    float score;    // 1.0 for an exact match, falling with each edit
+};
+
+class TrigramIndex {
+private:
+    unordered_map<uint32_t, vector<uint32_t>> postings;  // trigram -> sorted slots
+
+    static void documentTrigrams(const Book& record, vector<uint32_t>& out);
+
+public:
+    void clear();
+    void add(uint32_t slot, const Book& record);
+    void remove(uint32_t slot, const Book& record);
+    // Moves every slot to slotMap[slot] after the table was compacted;
+    // UINT32_MAX marks a removed record
+    void renumber(const vector<uint32_t>& slotMap);
+
+    // Slots sharing at least minShared query trigrams, most shared first.
+    // Const and free of shared scratch state, so queries may run in parallel.
+    vector<pair<uint32_t, int>> candidates(const vector<uint32_t>& query,
+                                           int minShared, size_t limit) const;
+
+    size_t trigramCount() const;
+};
+
+// Lowercases and replaces punctuation with single spaces
+string normaliseText(const string& text);
+
+// Distinct trigrams of already normalised text, padded at both ends
+void textTrigrams(const string& normalised, vector<uint32_t>& out);
+
+// Fewest edits turning the pattern into any substring of the text.
+// The pattern is truncated to 64 characters so it fits one machine word.
+int substringEditDistance(const string& pattern, const string& text);
+
+#endif
@@ -0,0 +1,241 @@
+/**
+ * Library Management System - Persistent ID Index Implementation
+ *
+ * Key points:
+ *   - Snapshots are written to a temporary file, synced and renamed,
+ *     so a reader never sees a half-written index
+ *   - The header checksum plus the data fingerprint (size, mtime and
+ *     a hash of the last block) decide whether a snapshot is current;
+ *     anything else is treated as stale and rebuilt by the engine
+ *   - Entries are never copied on load, lookups binary search the map
+ */
+
+#include "index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char INDEX_MAGIC[8] = { 'L', 'M', 'S', 'I', 'D', 'X', '0', '1' };
+    constexpr uint32_t INDEX_VERSION = 1;
+    constexpr size_t TAIL_BLOCK = 4096;
+
+    uint64_t headerChecksum(const IndexHeader& header) {
+        return fnv1a(&header, offsetof(IndexHeader, checksum));
+    }
+
+    bool writeAll(int fd, const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t written = write(fd, bytes, length);
+            if (written <= 0) return false;
+            bytes += written;
+            length -= written;
+        }
+        return true;
+    }
+}
+
+uint64_t fnv1a(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool fingerprintFile(const string& path, DataFingerprint& out) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+
+    out.size = info.st_size;
+#ifdef __APPLE__
+    out.mtimeNs = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    out.mtimeNs = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+
+    char tail[TAIL_BLOCK];
+    size_t length = min<uint64_t>(out.size, TAIL_BLOCK);
+    ssize_t got = pread(fd, tail, length, out.size - length);
+    close(fd);
+    if (got != static_cast<ssize_t>(length)) return false;
+
+    out.tailChecksum = fnv1a(tail, length);
+    return true;
+}
+
+IdIndex::IdIndex() :
+    entries(nullptr),
+    entryCount(0),
+    mapping(nullptr),
+    mappingSize(0) {
+}
+
+IdIndex::~IdIndex() {
+    unmap();
+}
+
+void IdIndex::unmap() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+bool IdIndex::load(const string& path, const DataFingerprint& data, IndexHeader& header) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0 &&
+                 static_cast<size_t>(info.st_size) >= sizeof(IndexHeader) &&
+                 pread(fd, &header, sizeof(header), 0) == sizeof(header);
+
+    valid = valid &&
+            memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+            header.version == INDEX_VERSION &&
+            header.checksum == headerChecksum(header) &&
+            header.dataSize == data.size &&
+            header.dataMtimeNs == data.mtimeNs &&
+            header.dataTailChecksum == data.tailChecksum &&
+            header.recordSize != 0 &&
+            header.recordCount == data.size / header.recordSize &&
+            static_cast<uint64_t>(info.st_size) ==
+                sizeof(IndexHeader) + header.entryCount * sizeof(IndexEntry);
+
+    void* mapped = MAP_FAILED;
+    if (valid && header.entryCount > 0) {
+        mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        valid = mapped != MAP_FAILED;
+    }
+    close(fd);
+
+    if (!valid) return false;
+
+    unmap();
+    owned.clear();
+    overlay.clear();
+    entryCount = header.entryCount;
+    if (mapped != MAP_FAILED) {
+        mapping = mapped;
+        mappingSize = info.st_size;
+        entries = reinterpret_cast<const IndexEntry*>(
+            static_cast<const char*>(mapped) + sizeof(IndexHeader));
+    } else {
+        entries = nullptr;
+    }
+    return true;
+}
+
+bool IdIndex::save(const string& path, const DataFingerprint& data, IndexHeader header) const {
+    vector<IndexEntry> all = merged();
+
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.entryCount = all.size();
+    header.dataSize = data.size;
+    header.dataMtimeNs = data.mtimeNs;
+    header.dataTailChecksum = data.tailChecksum;
+    header.reserved = 0;
+    header.checksum = headerChecksum(header);
+
+    string tempPath = path + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = writeAll(fd, &header, sizeof(header)) &&
+              writeAll(fd, all.data(), all.size() * sizeof(IndexEntry)) &&
+              fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool IdIndex::saveHeader(const string& path, const DataFingerprint& data, IndexHeader header) const {
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.entryCount = size();
+    header.dataSize = data.size;
+    header.dataMtimeNs = data.mtimeNs;
+    header.dataTailChecksum = data.tailChecksum;
+    header.reserved = 0;
+    header.checksum = headerChecksum(header);
+
+    // A torn header fails its checksum and is rebuilt, so no rename is needed
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header) && fsync(fd) == 0;
+    return close(fd) == 0 && ok;
+}
+
+void IdIndex::reset(vector<IndexEntry>&& sorted) {
+    unmap();
+    overlay.clear();
+    owned = move(sorted);
+    entries = owned.data();
+    entryCount = owned.size();
+}
+
+bool IdIndex::find(int32_t id, uint32_t& slot) const {
+    if (!overlay.empty()) {
+        auto it = overlay.find(id);
+        if (it != overlay.end()) {
+            slot = it->second;
+            return true;
+        }
+    }
+
+    const IndexEntry* end = entries + entryCount;
+    const IndexEntry* it = lower_bound(entries, end, id,
+        [](const IndexEntry& entry, int32_t key) { return entry.id < key; });
+    if (it == end || it->id != id) {
+        return false;
+    }
+    slot = it->slot;
+    return true;
+}
+
+void IdIndex::insert(int32_t id, uint32_t slot) {
+    overlay.emplace(id, slot);
+}
+
+size_t IdIndex::size() const {
+    return entryCount + overlay.size();
+}
+
+size_t IdIndex::overlaySize() const {
+    return overlay.size();
+}
+
+vector<IndexEntry> IdIndex::merged() const {
+    vector<IndexEntry> extra;
+    extra.reserve(overlay.size());
+    for (const auto& entry : overlay) {
+        extra.push_back({ entry.first, entry.second });
+    }
+    sort(extra.begin(), extra.end(),
+         [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; });
+
+    vector<IndexEntry> all(entryCount + extra.size());
+    merge(entries, entries + entryCount, extra.begin(), extra.end(), all.begin(),
+          [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; });
+    return all;
+}
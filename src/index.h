@@ -0,0 +1,90 @@
+/**
+ * Library Management System - Persistent ID Index
+ * Maps book ids to record slots in books.hot.
+ *
+ * The index is saved next to the database (books.idx) as a header
+ * followed by (id, slot) pairs sorted by id. That layout is searched
+ * in place through mmap, so reopening a large catalog does not scan
+ * the records or deserialise anything. Records added after the snapshot
+ * was taken live in a small in-memory overlay until the next save.
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct IndexEntry {
+    int32_t id;
+    uint32_t slot;
+};
+
+// Identifies the exact data file contents a snapshot was built from
+struct DataFingerprint {
+    uint64_t size;
+    int64_t mtimeNs;
+    uint64_t tailChecksum;  // hash of the last block of the file
+};
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;    // engine commit counter when saved
+    uint64_t recordCount;
+    uint64_t entryCount;
+    uint64_t dataSize;
+    int64_t dataMtimeNs;
+    uint64_t dataTailChecksum;
+    int32_t maxId;
+    uint32_t reserved;
+    uint64_t checksum;      // FNV-1a of every field above
+};
+
+class IdIndex {
+private:
+    const IndexEntry* entries;  // sorted by id, mapped or owned
+    size_t entryCount;
+    vector<IndexEntry> owned;
+    void* mapping;
+    size_t mappingSize;
+    unordered_map<int32_t, uint32_t> overlay;
+
+    void unmap();
+
+public:
+    IdIndex();
+    ~IdIndex();
+
+    IdIndex(const IdIndex&) = delete;
+    IdIndex& operator=(const IdIndex&) = delete;
+
+    // Maps a snapshot; fails if it is missing, corrupt or does not
+    // match the data file fingerprint
+    bool load(const string& path, const DataFingerprint& data, IndexHeader& header);
+    bool save(const string& path, const DataFingerprint& data, IndexHeader header) const;
+    // Rewrites only the header when the saved entries are still current
+    bool saveHeader(const string& path, const DataFingerprint& data, IndexHeader header) const;
+
+    // Replaces the contents with entries already sorted by id
+    void reset(vector<IndexEntry>&& sorted);
+
+    bool find(int32_t id, uint32_t& slot) const;
+    void insert(int32_t id, uint32_t slot);
+
+    size_t size() const;
+    size_t overlaySize() const;
+    vector<IndexEntry> merged() const;
+};
+
+// Hashing and file identity helpers shared with other sidecar files
+uint64_t fnv1a(const void* data, size_t length, uint64_t seed = 14695981039346656037ULL);
+bool fingerprintFile(const string& path, DataFingerprint& out);
+
+#endif
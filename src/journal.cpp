@@ -0,0 +1,142 @@
+/**
+ * Library Management System - Group-Commit Journal Implementation
+ *
+ * Key points:
+ *   - append() only copies into memory under the mutex
+ *   - The thread that performs a sync releases the mutex while it
+ *     writes, so new records keep queueing for the next round
+ *   - A failed write is sticky: every later waiter gets false until
+ *     a truncate() has emptied the log
+ */
+
+#include "journal.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int syncFileData(int fd) {
+#ifdef __APPLE__
+    return fsync(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+Journal::Journal() :
+    fd(-1),
+    appended(0),
+    durable(0),
+    fileSize(0),
+    syncing(false),
+    failed(false) {
+}
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const string& file) {
+    close();
+
+    path = file;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    fileSize = info.st_size;
+    failed = false;
+    return true;
+}
+
+void Journal::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+uint64_t Journal::append(const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    lock_guard<mutex> guard(lock);
+    pending.insert(pending.end(), bytes, bytes + length);
+    appended += length;
+    return appended;
+}
+
+bool Journal::waitDurable(uint64_t ticket) {
+    unique_lock<mutex> guard(lock);
+    while (durable < ticket && !failed) {
+        if (syncing) {
+            synced.wait(guard);
+            continue;
+        }
+
+        // Become the leader for everything queued so far
+        syncing = true;
+        vector<char> batch;
+        batch.swap(pending);
+        uint64_t target = appended;
+        guard.unlock();
+
+        bool ok = fd >= 0;
+        size_t offset = 0;
+        while (ok && offset < batch.size()) {
+            ssize_t written = write(fd, batch.data() + offset, batch.size() - offset);
+            ok = written > 0;
+            if (ok) offset += written;
+        }
+        ok = ok && syncFileData(fd) == 0;
+
+        guard.lock();
+        syncing = false;
+        if (ok) {
+            durable = target;
+            fileSize += batch.size();
+        } else {
+            failed = true;
+        }
+        synced.notify_all();
+    }
+    return durable >= ticket;
+}
+
+bool Journal::readAll(vector<char>& out) const {
+    lock_guard<mutex> guard(lock);
+    out.resize(fileSize);
+    size_t offset = 0;
+    while (offset < out.size()) {
+        ssize_t got = pread(fd, out.data() + offset, out.size() - offset, offset);
+        if (got <= 0) return false;
+        offset += got;
+    }
+    return true;
+}
+
+bool Journal::truncate() {
+    lock_guard<mutex> guard(lock);
+    if (fd < 0 || ftruncate(fd, 0) != 0 || syncFileData(fd) != 0) {
+        return false;
+    }
+    pending.clear();
+    durable = appended;
+    fileSize = 0;
+    // The caller made the records durable elsewhere, so a torn batch
+    // left by a failed write no longer matters
+    failed = false;
+    return true;
+}
+
+bool Journal::hasFailed() const {
+    lock_guard<mutex> guard(lock);
+    return failed;
+}
+
+uint64_t Journal::size() const {
+    lock_guard<mutex> guard(lock);
+    return fileSize + pending.size();
+}
@@ -0,0 +1,63 @@
+/**
+ * Library Management System - Group-Commit Journal
+ * Append-only log file that many threads can write to at once.
+ *
+ * Writers queue their bytes with append() and then wait for their
+ * ticket with waitDurable(). Whichever waiter arrives first writes and
+ * syncs everything queued so far, so one fdatasync covers every thread
+ * that was waiting instead of one sync per record.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Journal {
+private:
+    int fd;
+    string path;
+    mutable mutex lock;
+    condition_variable synced;
+    vector<char> pending;
+    uint64_t appended;   // bytes ever queued, doubles as the ticket
+    uint64_t durable;    // bytes known to be on disk
+    uint64_t fileSize;
+    bool syncing;
+    bool failed;
+
+public:
+    Journal();
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool open(const string& file);
+    void close();
+
+    // Queues a record and returns the ticket to wait for
+    uint64_t append(const void* data, size_t length);
+    // Blocks until the ticket is on disk; false if the log cannot be written
+    bool waitDurable(uint64_t ticket);
+
+    // Whole log as written so far (used for recovery)
+    bool readAll(vector<char>& out) const;
+    // Empties the log and clears a failed write; callers must make sure
+    // nobody is appending
+    bool truncate();
+    uint64_t size() const;
+    // A write or sync failed since the last open() or truncate()
+    bool hasFailed() const;
+};
+
+// fdatasync where available, fsync otherwise
+int syncFileData(int fd);
+
+#endif
@@ -1,120 +1,22 @@
-// Constructor - explain initialization of filenames and file handling
+// Constructor - the engine member opens the database
 
 /* Key points:
-    - Initializes three important files: main database, temporary, and backup
-    - Implements fail-safe file opening
-    - Throws runtime_error if database initialization fails
+    - All record storage lives in LibraryEngine (engine.h)
+    - With a trace file, every engine call is recorded (trace.h) just
+      before it is made, so library-replay sees the same storage load
+    - This class only handles prompts, validation messages and screens
+    - Engine construction throws runtime_error if the database cannot be opened
 */
 
 #include "library.h"
 
-LibrarySystem::LibrarySystem() : 
-    filename("books.dat"),
-    tempFilename("books.tmp"),
-    backupFilename("books.bak") {
-    if (!openFile("")) {
-        throw runtime_error("Failed to initialize database");
+LibrarySystem::LibrarySystem(const string& traceFile) {
+    if (!traceFile.empty() && !trace.open(traceFile)) {
+        throw runtime_error("Failed to open trace file " + traceFile);
     }
 }
 
 LibrarySystem::~LibrarySystem() {
-    closeFile();
-}
-
-// File operation methods - critical for data persistence
-/* Remember:
-    - Handles multiple file opening modes (read/write/append)
-    - Creates file if it doesn't exist
-    - Ensures proper file access for all operations
-*/
-bool LibrarySystem::openFile(const string& mode) {
-    if (file.is_open()) {
-        file.close();
-    }
-    
-    ios_base::openmode openMode = ios::binary | ios::in | ios::out | ios::app;
-    if (!mode.empty()) {
-        if (mode == "in") openMode = ios::binary | ios::in;
-        else if (mode == "out") openMode = ios::binary | ios::out;
-    }
-    
-    file.open(filename, openMode);
-    if (!file) {
-        file.clear();
-        file.open(filename, ios::binary | ios::out);
-        if (!file) {
-            return false;
-        }
-        file.close();
-        file.open(filename, openMode);
-    }
-    
-    return file.is_open();
-}
-
-bool LibrarySystem::closeFile() {
-    if (file.is_open()) {
-        file.close();
-    }
-    return true;
-}
-
-/**
- * Creates a backup of the current database file
- * Critical for data safety during modifications
- * Used before any operation that modifies data
- * Returns false if backup creation fails
- */
-bool LibrarySystem::createBackup() {
-    if (!closeFile()) return false;
-    
-    ifstream src(filename, ios::binary);
-    ofstream dst(backupFilename, ios::binary);
-    
-    if (!src || !dst) {
-        return false;
-    }
-    
-    dst << src.rdbuf();
-    
-    src.close();
-    dst.close();
-    
-    return openFile("");
-}
-
-/**
- * Restores database from backup file
- * Used when an operation fails to maintain data integrity
- * Ensures system can recover from failed operations
- * Returns false if restoration fails
- */
-bool LibrarySystem::restoreBackup() {
-    closeFile();
-    
-    if (remove(filename.c_str()) != 0) {
-        return false;
-    }
-    
-    if (rename(backupFilename.c_str(), filename.c_str()) != 0) {
-        return false;
-    }
-    
-    return openFile("");
-}
-
-bool LibrarySystem::commitChanges() {
-    closeFile();
-    
-    if (remove(filename.c_str()) != 0) {
-        return false;
-    }
-    
-    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
-        return false;
-    }
-    
-    return openFile("");
 }
 
 void LibrarySystem::clearInputBuffer() {
@@ -145,13 +47,22 @@ string LibrarySystem::formatId(int id) {
     return ss.str();
 }
 
-void LibrarySystem::safeStrCopy(char* dest, const string& src, size_t maxLen) {
-    if (src.empty()) {
-        dest[0] = '\0';
-    } else {
-        strncpy(dest, src.c_str(), maxLen - 1);
-        dest[maxLen - 1] = '\0';
-    }
+// Columns, widths and truncation all come from BOOK_SCHEMA (book.h)
+void LibrarySystem::showTableHeader() {
+    cout << "\n" << formatBookHeader() << endl;
+    cout << string(BOOK_ROW_WIDTH, '-') << endl;
+}
+
+void LibrarySystem::showTableRow(const Book& record) {
+    cout << formatBookRow(record) << endl;
+}
+
+void LibrarySystem::showBookDetails(const Book& book) {
+    cout << "ID: " << formatId(book.id) << endl;
+    cout << "Title: " << book.title << endl;
+    cout << "Author: " << book.author << endl;
+    cout << "Price: $" << fixed << setprecision(2) << book.price << endl;
+    cout << "Quantity: " << book.quantity << endl;
 }
 
 /**
@@ -235,44 +146,6 @@ bool LibrarySystem::getStringInput(string& value, size_t maxLen) {
     return true;
 }
 
-bool LibrarySystem::validateId(int id) {
-    if (id <= 0) return false;
-    
-    file.clear();
-    file.seekg(0, ios::beg);
-    Book temp;
-    while (file.read(reinterpret_cast<char*>(&temp), sizeof(Book))) {
-        if (temp.id == id) return false;
-    }
-    return true;
-}
-
-/**
- * Title validation ensures:
- * - Minimum length of 3 characters
- * - Maximum length within array bounds
- * - Proper string termination
- * - Returns false if validation fails
- */
-bool LibrarySystem::validateTitle(const string& title) {
-    if (title.length() < 3 || title.length() >= MAX_TITLE_LENGTH) return false;
-    return true;
-}
-
-bool LibrarySystem::validateAuthor(const string& author) {
-    if (author.length() < 2 || author.length() >= MAX_AUTHOR_LENGTH) return false;
-    return all_of(author.begin(), author.end(), 
-                 [](char c) { return isalpha(c) || isspace(c); });
-}
-
-bool LibrarySystem::validatePrice(float price) {
-    return price >= MIN_PRICE && price <= MAX_PRICE;
-}
-
-bool LibrarySystem::validateQuantity(int qty) {
-    return qty >= MIN_QUANTITY && qty <= MAX_QUANTITY;
-}
-
 /**
  * Adds new book to database with comprehensive validation:
  * 1. Automatic ID generation
@@ -288,47 +161,34 @@ void LibrarySystem::addBook() {
     do {
         showHeader("ADD NEW BOOK");
         
-        // Get the next ID
-        file.clear();
-        file.seekg(0, ios::end);
-        int lastPos = file.tellg();
-        int newId = 1;
-        
-        if (lastPos > 0) {
-            file.seekg(lastPos - sizeof(Book));
-            Book lastBook;
-            if (file.read(reinterpret_cast<char*>(&lastBook), sizeof(Book))) {
-                newId = lastBook.id + 1;
-            }
-        }
-        
-        book.id = newId;
+        Book book = {};
+        book.id = engine.nextId();
         
         // Get title
         do {
             cout << "\nEnter Book Title: ";
             if (!getStringInput(input, MAX_TITLE_LENGTH)) continue;
-            if (!validateTitle(input)) {
+            if (!LibraryEngine::validateTitle(input)) {
                 cout << "Invalid title! Title must be between 3 and " 
                      << (MAX_TITLE_LENGTH - 1) << " characters.\n";
                 continue;
             }
             break;
         } while (true);
-        safeStrCopy(book.title, input, MAX_TITLE_LENGTH);
+        safeStrCopy(book.title, input);
         
         // Get author
         do {
             cout << "Enter Author Name: ";
             if (!getStringInput(input, MAX_AUTHOR_LENGTH)) continue;
-            if (!validateAuthor(input)) {
+            if (!LibraryEngine::validateAuthor(input)) {
                 cout << "Invalid author name! Use only letters and spaces (2-" 
                      << (MAX_AUTHOR_LENGTH - 1) << " characters).\n";
                 continue;
             }
             break;
         } while (true);
-        safeStrCopy(book.author, input, MAX_AUTHOR_LENGTH);
+        safeStrCopy(book.author, input);
         
         // Get price
         float price;
@@ -337,7 +197,7 @@ void LibrarySystem::addBook() {
             if (!getNumericInput(price)) {
                 continue;
             }
-            if (!validatePrice(price)) {
+            if (!LibraryEngine::validatePrice(price)) {
                 cout << "Invalid price! Please enter a value between $" 
                      << MIN_PRICE << " and $" << MAX_PRICE << ".\n";
                 continue;
@@ -353,7 +213,7 @@ void LibrarySystem::addBook() {
             if (!getNumericInput(quantity)) {
                 continue;
             }
-            if (!validateQuantity(quantity)) {
+            if (!LibraryEngine::validateQuantity(quantity)) {
                 cout << "Invalid quantity! Please enter a value between " 
                      << MIN_QUANTITY << " and " << MAX_QUANTITY << ".\n";
                 continue;
@@ -362,27 +222,16 @@ void LibrarySystem::addBook() {
         } while (true);
         book.quantity = quantity;
         
-        // Set status
-        safeStrCopy(book.status, quantity > 0 ? "Available" : "Out", MAX_STATUS_LENGTH);
-        
-        // Create backup before writing
-        if (!createBackup()) {
-            cout << "\nError: Unable to create backup. Operation cancelled.\n";
+        // The engine sets the status, takes the backup and writes the record
+        TraceOp op = traceOp(TraceType::Add, book.id);
+        op.record = book;
+        trace.record(op);
+        if (!engine.put(book)) {
+            cout << "\nError: " << engine.lastError() << ". Operation cancelled.\n";
             pauseScreen();
             continue;
         }
         
-        // Write to file
-        file.clear();
-        file.seekp(0, ios::end);
-        if (!file.write(reinterpret_cast<char*>(&book), sizeof(Book))) {
-            cout << "\nError: Failed to write book record.\n";
-            restoreBackup();
-            pauseScreen();
-            continue;
-        }
-        
-        file.flush();
         cout << "\nBook added successfully!\n";
         
         do {
@@ -398,37 +247,73 @@ void LibrarySystem::addBook() {
     } while (continueAdding == 'Y');
 }
 
+/**
+ * Searches by ID, or by title/author when the input is not a number.
+ * Title searches tolerate typos and list the closest matches.
+ */
 void LibrarySystem::searchBook() {
     showHeader("SEARCH BOOK");
     
-    int searchId;
-    cout << "\nEnter Book ID to search: ";
-    if (!getNumericInput(searchId)) {
-        cout << "\nInvalid ID format!\n";
+    string input;
+    cout << "\nEnter Book ID or Title to search: ";
+    getline(cin, input);
+    
+    if (input.empty()) {
+        cout << "\nInvalid search!\n";
         pauseScreen();
         return;
     }
     
-    bool found = false;
-    file.clear();
-    file.seekg(0, ios::beg);
-    
-    while (file.read(reinterpret_cast<char*>(&book), sizeof(Book))) {
-        if (book.id == searchId) {
+    if (all_of(input.begin(), input.end(), ::isdigit)) {
+        Book book;
+        int searchId = 0;
+        try {
+            searchId = stoi(input);
+        } catch (...) {
+            cout << "\nInvalid ID format!\n";
+            pauseScreen();
+            return;
+        }
+        
+        trace.record(traceOp(TraceType::Search, searchId));
+        if (engine.get(searchId, book)) {
             cout << "\nBook Details:\n";
-            cout << "ID: " << formatId(book.id) << endl;
-            cout << "Title: " << book.title << endl;
-            cout << "Author: " << book.author << endl;
-            cout << "Price: $" << fixed << setprecision(2) << book.price << endl;
-            cout << "Quantity: " << book.quantity << endl;
+            showBookDetails(book);
             cout << "Status: " << book.status << endl;
-            found = true;
-            break;
+        } else {
+            cout << "\nBook not found!\n";
         }
+        pauseScreen();
+        return;
     }
     
-    if (!found) {
-        cout << "\nBook not found!\n";
+    TraceOp find = traceOp(TraceType::Find, 0);
+    find.query = input;
+    trace.record(find);
+    vector<FuzzyMatch> matches = engine.fuzzySearch(input, FUZZY_RESULTS);
+    if (matches.empty()) {
+        cout << "\nNo books match \"" << input << "\"!\n";
+        pauseScreen();
+        return;
+    }
+    
+    cout << "\nClosest matches:\n\n"
+        << left << setw(6) << "ID"
+        << setw(35) << "Title"
+        << setw(20) << "Author"
+        << right << setw(8) << "Match" << endl;
+    cout << string(69, '-') << endl;
+    
+    for (const FuzzyMatch& match : matches) {
+        string title(match.book.title);
+        string author(match.book.author);
+        if (title.length() > 32) title = title.substr(0, 29) + "...";
+        if (author.length() > 17) author = author.substr(0, 14) + "...";
+        
+        cout << left << setw(6) << formatId(match.book.id)
+            << setw(35) << title
+            << setw(20) << author
+            << right << setw(7) << static_cast<int>(match.score * 100 + 0.5f) << "%" << endl;
     }
     
     pauseScreen();
@@ -453,81 +338,52 @@ void LibrarySystem::updateBook() {
         return;
     }
     
-    // Create temporary file
-    fstream tempFile(tempFilename, ios::binary | ios::out);
-    if (!tempFile) {
-        cout << "\nError: Unable to create temporary file!\n";
+    Book book;
+    trace.record(traceOp(TraceType::Search, updateId));
+    if (!engine.get(updateId, book)) {
+        cout << "\nBook not found!\n";
         pauseScreen();
         return;
     }
     
-    bool found = false;
-    file.clear();
-    file.seekg(0, ios::beg);
-    
-    while (file.read(reinterpret_cast<char*>(&book), sizeof(Book))) {
-        if (book.id == updateId) {
-            cout << "\nCurrent Book Details:\n";
-            cout << "ID: " << formatId(book.id) << endl;
-            cout << "Title: " << book.title << endl;
-            cout << "Author: " << book.author << endl;
-            cout << "Price: $" << fixed << setprecision(2) << book.price << endl;
-            cout << "Quantity: " << book.quantity << endl;
-            
-            Book updatedBook = book;
-            string input;
-            
-            // Update title
-            cout << "\nEnter new Title (press Enter to keep current): ";
-            if (getStringInput(input, MAX_TITLE_LENGTH) && validateTitle(input)) {
-                safeStrCopy(updatedBook.title, input, MAX_TITLE_LENGTH);
-            }
-            
-            // Update author
-            cout << "Enter new Author (press Enter to keep current): ";
-            if (getStringInput(input, MAX_AUTHOR_LENGTH) && validateAuthor(input)) {
-                safeStrCopy(updatedBook.author, input, MAX_AUTHOR_LENGTH);
-            }
-            
-            // Update price
-            float newPrice;
-            cout << "Enter new Price (press Enter to keep current): ";
-            if (getNumericInput(newPrice) && validatePrice(newPrice)) {
-                updatedBook.price = newPrice;
-            }
-            
-            // Update quantity
-            int newQty;
-            cout << "Enter new Quantity (press Enter to keep current): ";
-            if (getNumericInput(newQty) && validateQuantity(newQty)) {
-                updatedBook.quantity = newQty;
-                safeStrCopy(updatedBook.status, newQty > 0 ? "Available" : "Out", MAX_STATUS_LENGTH);
-            }
-            
-            tempFile.write(reinterpret_cast<char*>(&updatedBook), sizeof(Book));
-            found = true;
-        } else {
-            tempFile.write(reinterpret_cast<char*>(&book), sizeof(Book));
-        }
+    cout << "\nCurrent Book Details:\n";
+    showBookDetails(book);
+    
+    // Invalid or empty answers keep the current value
+    BookPatch patch;
+    string input;
+    
+    cout << "\nEnter new Title (press Enter to keep current): ";
+    if (getStringInput(input, MAX_TITLE_LENGTH) && LibraryEngine::validateTitle(input)) {
+        patch.title = input;
     }
     
-    tempFile.close();
-    closeFile();
+    cout << "Enter new Author (press Enter to keep current): ";
+    if (getStringInput(input, MAX_AUTHOR_LENGTH) && LibraryEngine::validateAuthor(input)) {
+        patch.author = input;
+    }
     
-    if (found) {
-        if (commitChanges()) {
-            cout << "\nBook updated successfully!";
-        } else {
-            cout << "\nError: Unable to update database!";
-            remove(tempFilename.c_str());
-        }
+    float newPrice;
+    cout << "Enter new Price (press Enter to keep current): ";
+    if (getNumericInput(newPrice) && LibraryEngine::validatePrice(newPrice)) {
+        patch.price = newPrice;
+    }
+    
+    int newQty;
+    cout << "Enter new Quantity (press Enter to keep current): ";
+    if (getNumericInput(newQty) && LibraryEngine::validateQuantity(newQty)) {
+        patch.quantity = newQty;
+    }
+    
+    TraceOp op = traceOp(TraceType::Update, updateId);
+    op.patch = patch;
+    trace.record(op);
+    if (engine.update(updateId, patch)) {
+        cout << "\nBook updated successfully!\n";
     } else {
-        cout << "\nBook not found!";
-        remove(tempFilename.c_str());
+        cout << "\nError: " << engine.lastError() << "!\n";
     }
     
-    openFile("");
-    cout << "\n";
     pauseScreen();
 }
 
@@ -542,87 +398,80 @@ void LibrarySystem::deleteBook() {
         return;
     }
     
-    // Create temporary file
-    fstream tempFile(tempFilename, ios::binary | ios::out);
-    if (!tempFile) {
-        cout << "\nError: Unable to create temporary file!\n";
+    Book book;
+    trace.record(traceOp(TraceType::Search, deleteId));
+    if (!engine.get(deleteId, book)) {
+        cout << "\nBook not found!\n";
         pauseScreen();
         return;
     }
     
-    // First find the book to confirm deletion
-    file.clear();
-    file.seekg(0, ios::beg);
-    bool found = false;
-    
-    while (file.read(reinterpret_cast<char*>(&book), sizeof(Book))) {
-        if (book.id == deleteId) {
-            cout << "\nBook Details to Delete:\n";
-            cout << "ID: " << formatId(book.id) << endl;
-            cout << "Title: " << book.title << endl;
-            cout << "Author: " << book.author << endl;
-            cout << "Price: $" << fixed << setprecision(2) << book.price << endl;
-            cout << "Quantity: " << book.quantity << endl;
-            
-            char confirm;
-            do {
-                cout << "\nAre you sure you want to delete this book? (Y/N): ";
-                cin >> confirm;
-                clearInputBuffer();
-            } while (toupper(confirm) != 'Y' && toupper(confirm) != 'N');
-            
-            if (toupper(confirm) == 'N') {
-                cout << "\nDeletion cancelled.\n";
-                tempFile.close();
-                remove(tempFilename.c_str());
-                pauseScreen();
-                return;
-            }
-            
-            found = true;
-            break;
-        }
-    }
+    cout << "\nBook Details to Delete:\n";
+    showBookDetails(book);
     
-    if (!found) {
-        cout << "\nBook not found!\n";
-        tempFile.close();
-        remove(tempFilename.c_str());
-        pauseScreen();
-        return;
-    }
+    char confirm;
+    do {
+        cout << "\nAre you sure you want to delete this book? (Y/N): ";
+        cin >> confirm;
+        clearInputBuffer();
+    } while (toupper(confirm) != 'Y' && toupper(confirm) != 'N');
     
-    // Create backup before deletion
-    if (!createBackup()) {
-        cout << "\nError: Unable to create backup. Operation cancelled.\n";
-        tempFile.close();
-        remove(tempFilename.c_str());
+    if (toupper(confirm) == 'N') {
+        cout << "\nDeletion cancelled.\n";
         pauseScreen();
         return;
     }
     
-    // Copy all records except the one to be deleted
-    file.clear();
-    file.seekg(0, ios::beg);
-    
-    while (file.read(reinterpret_cast<char*>(&book), sizeof(Book))) {
-        if (book.id != deleteId) {
-            tempFile.write(reinterpret_cast<char*>(&book), sizeof(Book));
-        }
-    }
-    
-    tempFile.close();
-    closeFile();
-    
-    if (commitChanges()) {
+    trace.record(traceOp(TraceType::Delete, deleteId));
+    if (engine.erase(deleteId)) {
         cout << "\nBook deleted successfully!\n";
     } else {
-        cout << "\nError: Unable to delete book!\n";
-        restoreBackup();
-        remove(tempFilename.c_str());
+        cout << "\nError: Unable to delete book! " << engine.lastError() << "\n";
     }
     
-    openFile("");
+    pauseScreen();
+}
+
+void LibrarySystem::circulate(bool checkingOut) {
+    showHeader(checkingOut ? "CHECK OUT BOOK" : "RETURN BOOK");
+
+    int bookId;
+    cout << "\nEnter Book ID: ";
+    if (!getNumericInput(bookId)) {
+        cout << "\nInvalid ID format!\n";
+        pauseScreen();
+        return;
+    }
+
+    trace.record(traceOp(checkingOut ? TraceType::Checkout : TraceType::Return, bookId));
+    CirculationStatus result = checkingOut ? engine.checkout(bookId) : engine.returnBook(bookId);
+    switch (result) {
+        case CirculationStatus::Ok: {
+            Book book;
+            cout << (checkingOut ? "\nBook checked out successfully!\n" : "\nBook returned successfully!\n");
+            trace.record(traceOp(TraceType::Search, bookId));
+            if (engine.get(bookId, book)) {
+                showBookDetails(book);
+            }
+            break;
+        }
+        case CirculationStatus::NotFound:
+            cout << "\nBook not found!\n";
+            break;
+        case CirculationStatus::OutOfStock:
+            cout << "\nNo copies left to check out!\n";
+            break;
+        case CirculationStatus::AtCapacity:
+            cout << "\nQuantity is already at the maximum of " << MAX_QUANTITY << "!\n";
+            break;
+        case CirculationStatus::IoError:
+            cout << "\nError: Unable to record the change!\n";
+            break;
+        case CirculationStatus::NotDurable:
+            cout << "\nChange applied but not yet confirmed on disk; do not repeat it.\n";
+            break;
+    }
+
     pauseScreen();
 }
 
@@ -636,17 +485,9 @@ void LibrarySystem::deleteBook() {
  */
 void LibrarySystem::displayBooks() {
     int currentPage = 1;
-    int totalRecords = 0;
+    int totalRecords = static_cast<int>(engine.size());
     char choice;
     
-    // Count total records
-    file.clear();
-    file.seekg(0, ios::beg);
-    Book tempBook;
-    while (file.read(reinterpret_cast<char*>(&tempBook), sizeof(Book))) {
-        totalRecords++;
-    }
-    
     if (totalRecords == 0) {
         showHeader("DISPLAY ALL BOOKS");
         cout << "\nNo books found in the system!\n";
@@ -660,47 +501,16 @@ void LibrarySystem::displayBooks() {
         showHeader("DISPLAY ALL BOOKS");
         cout << "\nPage " << currentPage << " of " << totalPages << endl;
         
-        // Display table header
-        cout << "\n"
-            << left << setw(6) << "ID" 
-            << setw(35) << "Title"
-            << setw(20) << "Author"
-            << right << setw(10) << "Price"
-            << setw(10) << "Qty"
-            << setw(12) << "Status" << endl;
-        cout << string(93, '-') << endl;
+        showTableHeader();
         
-        // Calculate starting record for current page
+        // Read only the records of the current page
         int startRecord = (currentPage - 1) * RECORDS_PER_PAGE;
-        file.clear();
-        file.seekg(startRecord * sizeof(Book));
+        vector<Book> page;
         
-        // Display records for current page
-        int displayedRecords = 0;
-        while (displayedRecords < RECORDS_PER_PAGE && 
-            file.read(reinterpret_cast<char*>(&book), sizeof(Book))) {
-            // Ensure proper string termination for display
-            book.title[MAX_TITLE_LENGTH - 1] = '\0';
-            book.author[MAX_AUTHOR_LENGTH - 1] = '\0';
-            book.status[MAX_STATUS_LENGTH - 1] = '\0';
-            
-            // Format and display record
-            cout << left << setw(6) << formatId(book.id);
-            
-            // Truncate long strings for display
-            string title(book.title);
-            string author(book.author);
-            if (title.length() > 32) title = title.substr(0, 29) + "...";
-            if (author.length() > 17) author = author.substr(0, 14) + "...";
-            
-            cout << setw(35) << left << title;           
-            cout << setw(20) << left << author;          
-            cout << right << setw(10) << fixed << setprecision(2) << book.price;  
-            cout << setw(10) << book.quantity;            
-            cout << setw(12) << book.status;            
-            cout << endl;
-            
-            displayedRecords++;
+        trace.record(traceOp(TraceType::Display, currentPage));
+        engine.readRange(startRecord, RECORDS_PER_PAGE, page);
+        for (const Book& record : page) {
+            showTableRow(record);
         }
         
         // Display navigation options
@@ -737,8 +547,148 @@ void LibrarySystem::displayBooks() {
     } while (true);
 }
 
+void LibrarySystem::lowStockReport() {
+    showHeader("LOW STOCK REPORT");
+    
+    vector<Book> books = engine.lowStock(LOW_STOCK_THRESHOLD);
+    cout << "\nBooks with " << LOW_STOCK_THRESHOLD << " or fewer copies: " << books.size() << endl;
+    
+    if (!books.empty()) {
+        showTableHeader();
+        for (size_t i = 0; i < books.size() && i < REPORT_ROWS; i++) {
+            showTableRow(books[i]);
+        }
+        if (books.size() > REPORT_ROWS) {
+            cout << "... and " << (books.size() - REPORT_ROWS) << " more\n";
+        }
+    }
+    
+    pauseScreen();
+}
+
+/**
+ * Price and quantity range search:
+ * 1. Every bound is optional, Enter keeps the widest value
+ * 2. Both ranges must match (price AND quantity)
+ * 3. Shows the first REPORT_ROWS matches and the total count
+ */
+void LibrarySystem::rangeSearch() {
+    showHeader("PRICE / QUANTITY RANGE SEARCH");
+    
+    RangeFilter filter;
+    float price;
+    int qty;
+    
+    cout << "\nMinimum Price (press Enter for $0.00): ";
+    if (getNumericInput(price)) filter.minPrice = price;
+    cout << "Maximum Price (press Enter for $" << MAX_PRICE << "): ";
+    if (getNumericInput(price)) filter.maxPrice = price;
+    cout << "Minimum Quantity (press Enter for " << MIN_QUANTITY << "): ";
+    if (getNumericInput(qty)) filter.minQuantity = qty;
+    cout << "Maximum Quantity (press Enter for " << MAX_QUANTITY << "): ";
+    if (getNumericInput(qty)) filter.maxQuantity = qty;
+    
+    size_t shown = 0;
+    size_t total = 0;
+    cout << "\n";
+    showTableHeader();
+    engine.rangeQuery(filter, [&](const Book& record) {
+        if (shown < REPORT_ROWS) {
+            showTableRow(record);
+            shown++;
+        }
+        total++;
+        return true;
+    });
+    
+    if (total > shown) {
+        cout << "... and " << (total - shown) << " more\n";
+    }
+    cout << "\nMatching Books: " << total << endl;
+    
+    pauseScreen();
+}
+
+/**
+ * Top-K report:
+ * 1. Ranks by price, quantity or stock value (price x quantity)
+ * 2. Highest or lowest first, ties go to the lower ID
+ * 3. Enter keeps the default of REPORT_ROWS books
+ */
+void LibrarySystem::topReport() {
+    showHeader("TOP BOOKS REPORT");
+    
+    int keyChoice;
+    cout << "\nRank by:";
+    cout << "\n1. Price";
+    cout << "\n2. Quantity";
+    cout << "\n3. Stock Value (price x quantity)";
+    cout << "\n\nEnter your choice (1-3): ";
+    if (!getNumericInput(keyChoice) || keyChoice < 1 || keyChoice > 3) {
+        cout << "\nInvalid choice!\n";
+        pauseScreen();
+        return;
+    }
+    RankKey key = keyChoice == 1 ? RankKey::Price :
+                  keyChoice == 2 ? RankKey::Quantity : RankKey::Value;
+    
+    char order;
+    do {
+        cout << "Highest or lowest first? (H/L): ";
+        cin >> order;
+        clearInputBuffer();
+    } while (toupper(order) != 'H' && toupper(order) != 'L');
+    
+    int count = REPORT_ROWS;
+    cout << "Number of books (press Enter for " << REPORT_ROWS << "): ";
+    if (getNumericInput(count) && count <= 0) {
+        cout << "\nInvalid number of books!\n";
+        pauseScreen();
+        return;
+    }
+    
+    vector<Book> books = engine.topK(key, toupper(order) == 'H', count);
+    cout << "\n";
+    showTableHeader();
+    for (const Book& record : books) {
+        showTableRow(record);
+    }
+    cout << "\nBooks Shown: " << books.size() << endl;
+    
+    pauseScreen();
+}
+
+void LibrarySystem::reportsMenu() {
+    int choice = 0;
+    
+    do {
+        showHeader("REPORTS");
+        cout << "\n1. Low Stock Report";
+        cout << "\n2. Price / Quantity Range Search";
+        cout << "\n3. Top Books (price, quantity, stock value)";
+        cout << "\n4. Return to Main Menu";
+        cout << "\n\nEnter your choice (1-4): ";
+        
+        if (!getNumericInput(choice)) {
+            cout << "\nInvalid choice! Please enter a number between 1 and 4.\n";
+            pauseScreen();
+            continue;
+        }
+        
+        switch (choice) {
+            case 1: lowStockReport(); break;
+            case 2: rangeSearch(); break;
+            case 3: topReport(); break;
+            case 4: break;
+            default:
+                cout << "\nInvalid choice! Please enter a number between 1 and 4.\n";
+                pauseScreen();
+        }
+    } while (choice != 4);
+}
+
 void LibrarySystem::mainMenu() {
-    int choice;
+    int choice = 0;
     string input;
     
     do {
@@ -748,11 +698,14 @@ void LibrarySystem::mainMenu() {
         cout << "\n3. Update Book";
         cout << "\n4. Delete Book";
         cout << "\n5. Display All Books";
-        cout << "\n6. Exit";
-        cout << "\n\nEnter your choice (1-6): ";
+        cout << "\n6. Check Out Book";
+        cout << "\n7. Return Book";
+        cout << "\n8. Reports";
+        cout << "\n9. Exit";
+        cout << "\n\nEnter your choice (1-9): ";
         
         if (!getNumericInput(choice)) {
-            cout << "\nInvalid choice! Please enter a number between 1 and 6.\n";
+            cout << "\nInvalid choice! Please enter a number between 1 and 9.\n";
             pauseScreen();
             continue;
         }
@@ -764,11 +717,14 @@ void LibrarySystem::mainMenu() {
                 case 3: updateBook(); break;
                 case 4: deleteBook(); break;
                 case 5: displayBooks(); break;
-                case 6: 
+                case 6: circulate(true); break;
+                case 7: circulate(false); break;
+                case 8: reportsMenu(); break;
+                case 9:
                     cout << "\nThank you for using Library Management System!\n";
                     break;
                 default:
-                    cout << "\nInvalid choice! Please enter a number between 1 and 6.\n";
+                    cout << "\nInvalid choice! Please enter a number between 1 and 9.\n";
                     pauseScreen();
             }
         } catch (const exception& e) {
@@ -778,5 +734,5 @@ void LibrarySystem::mainMenu() {
             cout << "\nAn unexpected error occurred!\n";
             pauseScreen();
         }
-    } while (choice != 6);
+    } while (choice != 9);
 }
\ No newline at end of file
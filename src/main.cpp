@@ -11,6 +11,10 @@
  * - Update existing book records
  * - Delete books from the system
  * - Display all books with pagination
+ * - Follow the change feed: library tail --from <seq> [--no-follow]
+ * - Backups: library backup | backups | restore <point> [--to <file>]
+ * - Top-K reports: library top <price|quantity|value> [--lowest] [--limit <k>]
+ * - Record the menu session for library-replay: library --record <trace>
  * 
  * File Structure:
  * - main.cpp: Program entry point
@@ -19,10 +23,202 @@
  */
 
 #include "library.h"
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
 #include <iostream>
+#include <thread>
+
+namespace {
+    constexpr size_t TAIL_BATCH = 1024;
+    constexpr auto TAIL_POLL = chrono::milliseconds(200);
+    constexpr int VALUE_WIDTH = 13;
+
+    /**
+     * Prints change feed events as JSON lines, starting at --from.
+     * Keeps polling for new events unless --no-follow is given; a
+     * consumer resumes later from the last seq it saw plus one.
+     */
+    int tailChanges(int argc, char* argv[]) {
+        uint64_t from = 1;
+        bool follow = true;
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--from" && i + 1 < argc) {
+                from = max<uint64_t>(1, strtoull(argv[++i], nullptr, 10));
+            } else if (arg == "--no-follow") {
+                follow = false;
+            } else {
+                cerr << "Usage: " << argv[0] << " tail [--from <seq>] [--no-follow]" << endl;
+                return 1;
+            }
+        }
+
+        vector<ChangeEvent> events;
+        while (true) {
+            uint64_t firstAvailable;
+            events.clear();
+            if (!readChanges("books.cdc", from, TAIL_BATCH, events, firstAvailable)) {
+                cerr << "Changes before " << firstAvailable << " are no longer retained; "
+                     << "re-export the catalog and resume from there" << endl;
+                return 2;
+            }
+            for (const ChangeEvent& event : events) {
+                cout << formatChange(event) << '\n';
+            }
+            cout.flush();
+            if (!events.empty()) {
+                from = events.back().sequence + 1;
+            }
+
+            if (events.size() < TAIL_BATCH) {
+                if (!follow) return 0;
+                this_thread::sleep_for(TAIL_POLL);
+            }
+        }
+    }
+
+    /**
+     * Ranks the catalog without sorting it:
+     *   top <price|quantity|value> [--lowest] [--limit <k>] [--threads <n>]
+     * Prints one row per book, best first; the timing goes to stderr
+     * so the rows can be piped elsewhere.
+     */
+    int topCommand(int argc, char* argv[]) {
+        string usage = string("Usage: ") + argv[0] +
+                       " top <price|quantity|value> [--lowest] [--limit <k>] [--threads <n>]";
+        if (argc < 3) {
+            cerr << usage << endl;
+            return 1;
+        }
+
+        string keyName = argv[2];
+        RankKey key;
+        if (keyName == "price") {
+            key = RankKey::Price;
+        } else if (keyName == "quantity") {
+            key = RankKey::Quantity;
+        } else if (keyName == "value") {
+            key = RankKey::Value;
+        } else {
+            cerr << usage << endl;
+            return 1;
+        }
+
+        bool highest = true;
+        size_t limit = REPORT_ROWS;
+        unsigned threads = 0;
+        for (int i = 3; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--lowest") {
+                highest = false;
+            } else if (arg == "--limit" && i + 1 < argc) {
+                limit = strtoull(argv[++i], nullptr, 10);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+            } else {
+                cerr << usage << endl;
+                return 1;
+            }
+        }
+
+        LibraryEngine engine;
+        auto start = chrono::steady_clock::now();
+        vector<Book> books = engine.topK(key, highest, limit, threads);
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+        // The menu's table (BOOK_SCHEMA columns) plus the stock value
+        cout << formatBookHeader() << setw(VALUE_WIDTH) << "Value" << '\n';
+        cout << fixed << setprecision(2);
+        for (const Book& book : books) {
+            cout << formatBookRow(book) << setw(VALUE_WIDTH) << static_cast<double>(book.price) * book.quantity << '\n';
+        }
+        cerr << books.size() << " of " << engine.size() << " books ranked in "
+             << setprecision(1) << elapsed.count() << " ms" << endl;
+        return 0;
+    }
+
+    void showBackup(const BackupInfo& info) {
+        time_t seconds = info.timeNs / 1000000000;
+        cout << setw(6) << info.point << "  " << left << setw(6) << (info.full ? "full" : "delta") << right
+             << setw(10) << info.recordCount << setw(10) << info.recordsStored
+             << "  " << put_time(localtime(&seconds), "%Y-%m-%d %H:%M:%S")
+             << setw(12) << info.changeSequence << '\n';
+    }
+
+    /**
+     * Backup commands, meant for cron or an operator:
+     *   backup                        take the next point (delta or full)
+     *   backups                       list the chain
+     *   restore <point> [--to <file>] roll the table back, or write a copy
+     */
+    int backupCommand(int argc, char* argv[]) {
+        string command = argv[1];
+        LibraryEngine engine;
+
+        if (command == "backup") {
+            BackupInfo info;
+            auto start = chrono::steady_clock::now();
+            if (!engine.backup(&info)) {
+                cerr << "Backup failed: " << engine.lastError() << endl;
+                return 1;
+            }
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+            cout << "Created " << (info.full ? "full" : "delta") << " backup " << info.point
+                 << " (" << info.recordsStored << " records) in " << fixed << setprecision(1)
+                 << elapsed.count() << " ms\n";
+            return 0;
+        }
+
+        if (command == "backups") {
+            cout << " Point  Type     Records    Stored  Taken at             Change seq\n";
+            for (const BackupInfo& info : engine.backups()) {
+                showBackup(info);
+            }
+            return 0;
+        }
+
+        if (argc != 3 && !(argc == 5 && string(argv[3]) == "--to")) {
+            cerr << "Usage: " << argv[0] << " restore <point> [--to <file>]" << endl;
+            return 1;
+        }
+        uint32_t point = static_cast<uint32_t>(strtoul(argv[2], nullptr, 10));
+        bool restored = argc == 5 ? engine.restoreTo(point, argv[4]) : engine.restore(point);
+        if (!restored) {
+            cerr << "Restore failed: " << (engine.lastError().empty() ? "unknown backup point" : engine.lastError()) << endl;
+            return 1;
+        }
+        cout << "Restored backup " << point << (argc == 5 ? string(" to ") + argv[4] : string()) << '\n';
+        return 0;
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "tail") {
+        return tailChanges(argc, argv);
+    }
 
-int main() {
     try {
+        if (argc == 3 && string(argv[1]) == "--record") {
+            LibrarySystem library(argv[2]);
+            library.mainMenu();
+            return 0;
+        }
+
+        if (argc > 1) {
+            string command = argv[1];
+            if (command == "backup" || command == "backups" || command == "restore") {
+                return backupCommand(argc, argv);
+            }
+            if (command == "top") {
+                return topCommand(argc, argv);
+            }
+            cerr << "Unknown command: " << command << endl;
+            return 1;
+        }
+
         LibrarySystem library;
         library.mainMenu();
     } catch (const exception& e) {
@@ -0,0 +1,126 @@
+/**
+ * Library Management System - Numeric Range Index Implementation
+ *
+ * Key points:
+ *   - Whole buckets inside a range are copied without checking values
+ *   - Only the first and last bucket consult the per-slot values
+ *   - New records arrive with increasing slots, so adding is usually
+ *     an append to the end of a bucket
+ */
+
+#include "range.h"
+
+#include <algorithm>
+
+BucketIndex::BucketIndex(int32_t maxKey, int32_t bucketWidth) :
+    maxKey(maxKey),
+    bucketWidth(bucketWidth),
+    buckets(maxKey / bucketWidth + 1) {
+}
+
+size_t BucketIndex::bucketOf(int32_t key) const {
+    return static_cast<size_t>(min(max(key, 0), maxKey) / bucketWidth);
+}
+
+void BucketIndex::clear() {
+    for (vector<uint32_t>& bucket : buckets) {
+        bucket.clear();
+    }
+    keys.clear();
+}
+
+void BucketIndex::add(uint32_t slot, int32_t key) {
+    key = min(max(key, 0), maxKey);
+    if (slot >= keys.size()) {
+        keys.resize(slot + 1, -1);
+    }
+    if (keys[slot] >= 0) {
+        remove(slot);
+    }
+    keys[slot] = key;
+
+    vector<uint32_t>& bucket = buckets[bucketOf(key)];
+    if (bucket.empty() || bucket.back() < slot) {
+        bucket.push_back(slot);
+    } else {
+        bucket.insert(lower_bound(bucket.begin(), bucket.end(), slot), slot);
+    }
+}
+
+void BucketIndex::remove(uint32_t slot) {
+    if (slot >= keys.size() || keys[slot] < 0) return;
+
+    vector<uint32_t>& bucket = buckets[bucketOf(keys[slot])];
+    auto it = lower_bound(bucket.begin(), bucket.end(), slot);
+    if (it != bucket.end() && *it == slot) {
+        bucket.erase(it);
+    }
+    keys[slot] = -1;
+}
+
+void BucketIndex::renumber(const vector<uint32_t>& slotMap) {
+    auto moved = [&](uint32_t slot) {
+        return slot < slotMap.size() ? slotMap[slot] : UINT32_MAX;
+    };
+
+    for (vector<uint32_t>& bucket : buckets) {
+        size_t kept = 0;
+        for (uint32_t slot : bucket) {
+            if (moved(slot) != UINT32_MAX) {
+                bucket[kept++] = moved(slot);
+            }
+        }
+        bucket.resize(kept);
+    }
+
+    vector<int32_t> movedKeys;
+    for (uint32_t slot = 0; slot < keys.size(); slot++) {
+        uint32_t target = moved(slot);
+        if (target == UINT32_MAX) continue;
+        if (target >= movedKeys.size()) {
+            movedKeys.resize(target + 1, -1);
+        }
+        movedKeys[target] = keys[slot];
+    }
+    keys.swap(movedKeys);
+}
+
+bool BucketIndex::contains(uint32_t slot, int32_t low, int32_t high) const {
+    return slot < keys.size() && keys[slot] >= 0 &&
+           keys[slot] >= low && keys[slot] <= high;
+}
+
+size_t BucketIndex::estimate(int32_t low, int32_t high) const {
+    if (low > high || high < 0 || low > maxKey) return 0;
+
+    size_t total = 0;
+    for (size_t b = bucketOf(low); b <= bucketOf(high); b++) {
+        total += buckets[b].size();
+    }
+    return total;
+}
+
+vector<uint32_t> BucketIndex::query(int32_t low, int32_t high) const {
+    vector<uint32_t> result;
+    if (low > high || high < 0 || low > maxKey) return result;
+
+    size_t first = bucketOf(low);
+    size_t last = bucketOf(high);
+    for (size_t b = first; b <= last; b++) {
+        const vector<uint32_t>& bucket = buckets[b];
+        if (b != first && b != last) {
+            result.insert(result.end(), bucket.begin(), bucket.end());
+            continue;
+        }
+        for (uint32_t slot : bucket) {
+            if (keys[slot] >= low && keys[slot] <= high) {
+                result.push_back(slot);
+            }
+        }
+    }
+
+    if (first != last) {
+        sort(result.begin(), result.end());
+    }
+    return result;
+}
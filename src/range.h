@@ -0,0 +1,48 @@
+/**
+ * Library Management System - Numeric Range Index
+ * Answers "value between A and B" over an integer-valued field
+ * without reading any book records.
+ *
+ * Values fall into fixed-width buckets, each holding the sorted slots
+ * of the records inside it. The exact value of every slot is kept as
+ * well, so the two partial buckets at the ends of a range are filtered
+ * in memory and a second index can test candidates from the first.
+ */
+
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class BucketIndex {
+private:
+    int32_t maxKey;
+    int32_t bucketWidth;
+    vector<vector<uint32_t>> buckets;  // bucket -> sorted slots
+    vector<int32_t> keys;              // slot -> value, -1 when absent
+
+    size_t bucketOf(int32_t key) const;
+
+public:
+    // Keys are clamped to [0, maxKey]
+    BucketIndex(int32_t maxKey, int32_t bucketWidth);
+
+    void clear();
+    void add(uint32_t slot, int32_t key);
+    void remove(uint32_t slot);
+    // Moves every slot to slotMap[slot] after the table was compacted;
+    // UINT32_MAX marks a removed record
+    void renumber(const vector<uint32_t>& slotMap);
+
+    bool contains(uint32_t slot, int32_t low, int32_t high) const;
+    // Upper bound on matches, read from bucket sizes only
+    size_t estimate(int32_t low, int32_t high) const;
+    // Matching slots in ascending order
+    vector<uint32_t> query(int32_t low, int32_t high) const;
+};
+
+#endif
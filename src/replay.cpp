@@ -0,0 +1,453 @@
+/**
+ * Library Management System - Workload Replay
+ *
+ * Usage: library-replay [options]
+ *   --trace <file>      replay a recorded trace (library --record <file>)
+ *   --synthetic <ops>   generate a workload instead (default 100000 ops)
+ *   --books <n>         books in the scratch database (default 10000)
+ *   --zipf <s>          skew of synthetic book ids, 0 for uniform (0.99)
+ *   --mix <op=w,...>    synthetic operation weights, for example
+ *                       search=80,update=20 (names as in trace.h)
+ *   --threads <n>       concurrent workers (default 4)
+ *   --rate <ops/s>      pace operations at a fixed rate; 0 runs them
+ *                       as fast as possible
+ *   --speed <x>         play a trace x times faster than recorded
+ *   --interval <ms>     reporting interval (default 1000)
+ *   --data <file>       use this database instead of a scratch copy
+ *   --save <file>       write the synthetic workload as a trace
+ *   --seed <n>          random seed for synthetic workloads
+ *
+ * A trace's adds take fresh ids from the replay database, and each
+ * book's operations stay on one worker in recorded order.
+ * Without --rate a trace keeps its recorded timing and a synthetic
+ * workload runs unpaced. Paced operations are timed from their
+ * scheduled start, so a stalled engine shows up as latency instead
+ * of quietly lowering the offered load.
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
+
+namespace {
+    const char* SCRATCH_FILE = "replay.dat";
+    constexpr size_t POPULATE_BATCH = 100000;
+
+    struct Options {
+        string tracePath;
+        string dataPath;
+        string savePath;
+        size_t operations = 100000;
+        int books = 10000;
+        double zipf = 0.99;
+        double rate = -1.0;             // negative: not given
+        double speed = 1.0;
+        unsigned threads = 4;
+        int intervalMs = 1000;
+        uint64_t seed = 1;
+        // Deletes rewrite the whole table, so they stay rare by default
+        double mix[TRACE_TYPES] = { 2, 50, 5, 10, 1, 2, 15, 15 };
+    };
+
+    struct Sample {
+        int64_t latencyNs;
+        TraceType type;
+        bool ok;
+    };
+
+    // Samples from one worker, drained by the reporter every interval
+    struct WorkerLog {
+        mutex lock;
+        vector<Sample> samples;
+    };
+
+    // Ranks 1..n with probability proportional to 1 / rank^s
+    class ZipfGenerator {
+    private:
+        vector<double> cdf;
+
+    public:
+        ZipfGenerator(size_t n, double s) : cdf(max<size_t>(n, 1)) {
+            double total = 0.0;
+            for (size_t rank = 1; rank <= cdf.size(); rank++) {
+                total += 1.0 / pow(static_cast<double>(rank), s);
+                cdf[rank - 1] = total;
+            }
+            for (double& value : cdf) {
+                value /= total;
+            }
+        }
+
+        size_t next(mt19937_64& random) const {
+            double point = uniform_real_distribution<double>(0.0, 1.0)(random);
+            size_t index = upper_bound(cdf.begin(), cdf.end(), point) - cdf.begin();
+            return min(index, cdf.size() - 1) + 1;
+        }
+    };
+
+    Book replayBook(int id, mt19937_64& random) {
+        Book record = {};
+        record.id = id;
+        safeStrCopy(record.title, "Replay Title " + to_string(id));
+        safeStrCopy(record.author, "Replay Author");
+        record.price = uniform_int_distribution<int>(100, 10000)(random) / 100.0f;
+        record.quantity = MAX_QUANTITY / 2;
+        return record;
+    }
+
+    bool populate(LibraryEngine& engine, int books, mt19937_64& random) {
+        vector<Book> records;
+        for (int id = 1; id <= books; id++) {
+            records.push_back(replayBook(id, random));
+            if (records.size() == POPULATE_BATCH || id == books) {
+                if (!engine.putBatch(records)) return false;
+                records.clear();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Builds the synthetic workload: Zipf ranks pick books of the
+     * current catalog (rank r is the r-th book in table order, found
+     * with one scan), so a few titles take most of the traffic, the
+     * way popular books do, whatever ids --data uses. Deletes remove
+     * books the workload added itself, oldest first, so the popular
+     * titles stay in the catalog; with none left a delete is an add.
+     */
+    vector<TraceOp> synthesize(const Options& options, LibraryEngine& engine, mt19937_64& random) {
+        vector<int> catalogIds;
+        vector<string> catalogTitles;
+        engine.scan(nullptr, [&](const Book& record) {
+            catalogIds.push_back(record.id);
+            catalogTitles.push_back(record.title);
+            return true;
+        });
+        int nextId = engine.nextId();
+        ZipfGenerator ranks(catalogIds.size(), options.zipf);
+        discrete_distribution<int> types(begin(options.mix), end(options.mix));
+        uniform_int_distribution<int> quantity(MIN_QUANTITY, MAX_QUANTITY);
+
+        vector<TraceOp> ops;
+        deque<int> added;
+        ops.reserve(options.operations);
+        for (size_t i = 0; i < options.operations; i++) {
+            size_t rank = ranks.next(random);
+            int id = rank <= catalogIds.size() ? catalogIds[rank - 1] : static_cast<int>(rank);
+            TraceOp op = traceOp(static_cast<TraceType>(types(random)), id);
+            if (options.rate > 0) {
+                op.atUs = static_cast<int64_t>(i * 1e6 / options.rate);
+            }
+            if (op.type == TraceType::Delete) {
+                if (added.empty()) {
+                    op.type = TraceType::Add;
+                } else {
+                    op.id = added.front();
+                    added.pop_front();
+                }
+            }
+            switch (op.type) {
+                case TraceType::Add:
+                    op.id = nextId++;
+                    op.record = replayBook(op.id, random);
+                    added.push_back(op.id);
+                    break;
+                case TraceType::Find:
+                    // Drop one character so the search has a typo to forgive
+                    op.query = rank <= catalogTitles.size() ? catalogTitles[rank - 1] : "Replay Title " + to_string(op.id);
+                    op.query.erase(random() % op.query.size(), 1);
+                    break;
+                case TraceType::Update:
+                    op.patch.quantity = quantity(random);
+                    break;
+                case TraceType::Display:
+                    op.id = static_cast<int>((rank - 1) / RECORDS_PER_PAGE + 1);
+                    break;
+                default:
+                    break;
+            }
+            ops.push_back(move(op));
+        }
+        return ops;
+    }
+
+    /**
+     * A recorded trace names the ids its session's database handed out,
+     * which the replay database may already use. Every recorded add gets
+     * the replay database's next free id instead, and later operations
+     * on that book follow it; ids the trace never added are left alone.
+     */
+    void remapAddedIds(vector<TraceOp>& ops, int nextId) {
+        unordered_map<int, int> added;
+        for (TraceOp& op : ops) {
+            if (op.type == TraceType::Add) {
+                added[op.id] = nextId;
+                op.id = op.record.id = nextId++;
+                continue;
+            }
+            bool book = op.type != TraceType::Find && op.type != TraceType::Display;
+            auto it = book ? added.find(op.id) : added.end();
+            if (it != added.end()) {
+                op.id = it->second;
+            }
+        }
+    }
+
+    // Operations on the same book run on the same worker, in trace order;
+    // page views and title searches touch no single book and spread out
+    vector<vector<size_t>> shardByBook(const vector<TraceOp>& ops, unsigned workers) {
+        vector<vector<size_t>> shards(workers);
+        for (size_t i = 0; i < ops.size(); i++) {
+            bool book = ops[i].type != TraceType::Find && ops[i].type != TraceType::Display;
+            shards[(book ? static_cast<size_t>(ops[i].id) : i) % workers].push_back(i);
+        }
+        return shards;
+    }
+
+    bool parseMix(const string& text, double (&mix)[TRACE_TYPES]) {
+        fill(begin(mix), end(mix), 0.0);
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t comma = text.find(',', begin);
+            string entry = text.substr(begin, comma == string::npos ? string::npos : comma - begin);
+            size_t equals = entry.find('=');
+            TraceType type;
+            if (equals == string::npos || !parseTraceType(entry.substr(0, equals), type)) return false;
+            mix[static_cast<size_t>(type)] = max(0.0, atof(entry.c_str() + equals + 1));
+            if (comma == string::npos) break;
+            begin = comma + 1;
+        }
+        return any_of(std::begin(mix), std::end(mix), [](double weight) { return weight > 0; });
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (i + 1 >= argc) return false;
+            const char* value = argv[++i];
+            if (arg == "--trace") {
+                options.tracePath = value;
+            } else if (arg == "--synthetic") {
+                options.operations = strtoull(value, nullptr, 10);
+            } else if (arg == "--books") {
+                options.books = atoi(value);
+            } else if (arg == "--zipf") {
+                options.zipf = atof(value);
+            } else if (arg == "--mix") {
+                if (!parseMix(value, options.mix)) return false;
+            } else if (arg == "--threads") {
+                options.threads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            } else if (arg == "--rate") {
+                options.rate = atof(value);
+            } else if (arg == "--speed") {
+                options.speed = atof(value);
+            } else if (arg == "--interval") {
+                options.intervalMs = atoi(value);
+            } else if (arg == "--data") {
+                options.dataPath = value;
+            } else if (arg == "--save") {
+                options.savePath = value;
+            } else if (arg == "--seed") {
+                options.seed = strtoull(value, nullptr, 10);
+            } else {
+                return false;
+            }
+        }
+        return options.operations > 0 && options.books >= 0 && options.zipf >= 0 &&
+               options.threads > 0 && options.speed > 0 && options.intervalMs > 0;
+    }
+
+    // Nearest-rank percentile of sorted latencies, in microseconds
+    double percentileUs(const vector<int64_t>& sorted, double percent) {
+        if (sorted.empty()) return 0.0;
+        size_t rank = static_cast<size_t>(ceil(percent / 100.0 * sorted.size()));
+        return sorted[min(max<size_t>(rank, 1), sorted.size()) - 1] / 1000.0;
+    }
+
+    void printLatencies(vector<int64_t>& latencies) {
+        sort(latencies.begin(), latencies.end());
+        printf(" %9.1f %9.1f %9.1f %9.1f\n", percentileUs(latencies, 50), percentileUs(latencies, 95),
+               percentileUs(latencies, 99), percentileUs(latencies, 100));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--trace <file> | --synthetic <ops>] [--books <n>] [--zipf <s>]\n"
+             << "       [--mix <op=weight,...>] [--threads <n>] [--rate <ops/s>] [--speed <x>]\n"
+             << "       [--interval <ms>] [--data <file>] [--save <file>] [--seed <n>]" << endl;
+        return 1;
+    }
+
+    try {
+        if (options.dataPath.empty()) {
+            LibraryEngine::removeFiles(SCRATCH_FILE);
+        }
+        LibraryEngine engine(options.dataPath.empty() ? SCRATCH_FILE : options.dataPath);
+        mt19937_64 random(options.seed);
+        if (engine.size() == 0 && !populate(engine, options.books, random)) {
+            cerr << "Unable to create replay data: " << engine.lastError() << endl;
+            return 1;
+        }
+
+        vector<TraceOp> ops;
+        string error;
+        if (!options.tracePath.empty() && !readTrace(options.tracePath, ops, error)) {
+            cerr << "Unable to read trace: " << error << endl;
+            return 1;
+        }
+        bool synthetic = options.tracePath.empty();
+        if (synthetic) {
+            ops = synthesize(options, engine, random);
+        } else {
+            remapAddedIds(ops, engine.nextId());
+        }
+        if (!options.savePath.empty()) {
+            TraceWriter writer;
+            if (!writer.open(options.savePath)) {
+                cerr << "Unable to write " << options.savePath << endl;
+                return 1;
+            }
+            for (const TraceOp& op : ops) {
+                writer.write(op);
+            }
+        }
+
+        // Scheduled start of each operation, relative to the run start
+        bool paced = options.rate > 0 || (!synthetic && options.rate < 0);
+        vector<int64_t> scheduleNs(ops.size());
+        for (size_t i = 0; i < ops.size(); i++) {
+            scheduleNs[i] = options.rate > 0 ? static_cast<int64_t>(i * 1e9 / options.rate)
+                                             : static_cast<int64_t>(ops[i].atUs * 1000 / options.speed);
+        }
+
+        printf("Replaying %zu operations (%s) on %zu books, %u threads, ", ops.size(),
+               synthetic ? "synthetic" : options.tracePath.c_str(), engine.size(), options.threads);
+        if (options.rate > 0) {
+            printf("%.0f ops/s\n\n", options.rate);
+        } else {
+            printf(paced ? "recorded timing x%.2f\n\n" : "unpaced\n\n", options.speed);
+        }
+        printf("   Time       Ops     Ops/s   Failed    p50 us    p95 us    p99 us    max us\n");
+
+        // A synthetic workload shares one queue, so hot books see real
+        // contention; a trace is sharded so each book's operations keep
+        // their recorded order (an add before the checkouts of its book)
+        vector<vector<size_t>> shards;
+        if (!synthetic) {
+            shards = shardByBook(ops, options.threads);
+        }
+        vector<WorkerLog> logs(options.threads);
+        atomic<size_t> next(0);
+        unsigned running = options.threads;
+        mutex runningLock;
+        condition_variable done;
+        auto start = chrono::steady_clock::now();
+
+        vector<thread> workers;
+        for (unsigned w = 0; w < options.threads; w++) {
+            workers.emplace_back([&, w]() {
+                size_t taken = 0;
+                auto nextOp = [&]() {
+                    if (synthetic) return next++;
+                    return taken < shards[w].size() ? shards[w][taken++] : ops.size();
+                };
+                for (size_t i = nextOp(); i < ops.size(); i = nextOp()) {
+                    auto begin = chrono::steady_clock::now();
+                    if (paced) {
+                        begin = start + chrono::nanoseconds(scheduleNs[i]);
+                        this_thread::sleep_until(begin);
+                    }
+                    bool ok = runTraceOp(engine, ops[i]);
+                    int64_t latency = chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - begin).count();
+                    lock_guard<mutex> guard(logs[w].lock);
+                    logs[w].samples.push_back({ latency, ops[i].type, ok });
+                }
+                lock_guard<mutex> guard(runningLock);
+                if (--running == 0) done.notify_one();
+            });
+        }
+
+        // Per-interval report while the workers run
+        vector<int64_t> byType[TRACE_TYPES];
+        size_t failedByType[TRACE_TYPES] = {};
+        vector<Sample> drained;
+        double reported = 0.0;
+        for (int tick = 1; ; tick++) {
+            // Wakes early when the last worker finishes
+            bool finished;
+            {
+                unique_lock<mutex> guard(runningLock);
+                finished = done.wait_until(guard, start + chrono::milliseconds(tick * options.intervalMs),
+                                           [&]() { return running == 0; });
+            }
+
+            drained.clear();
+            for (WorkerLog& log : logs) {
+                lock_guard<mutex> guard(log.lock);
+                drained.insert(drained.end(), log.samples.begin(), log.samples.end());
+                log.samples.clear();
+            }
+
+            vector<int64_t> latencies;
+            size_t failed = 0;
+            for (const Sample& sample : drained) {
+                size_t type = static_cast<size_t>(sample.type);
+                latencies.push_back(sample.latencyNs);
+                byType[type].push_back(sample.latencyNs);
+                failed += !sample.ok;
+                failedByType[type] += !sample.ok;
+            }
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double window = elapsed - reported;
+            reported = elapsed;
+            printf("%6.1fs %9zu %9.0f %8zu", elapsed, latencies.size(),
+                   window > 0 ? latencies.size() / window : 0.0, failed);
+            printLatencies(latencies);
+
+            if (finished) break;
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("\nOperation     Count     Ops/s   Failed    p50 us    p95 us    p99 us    max us\n");
+        vector<int64_t> all;
+        size_t failed = 0;
+        for (size_t type = 0; type < TRACE_TYPES; type++) {
+            if (byType[type].empty()) continue;
+            all.insert(all.end(), byType[type].begin(), byType[type].end());
+            failed += failedByType[type];
+            printf("%-9s %9zu %9.0f %8zu", traceTypeName(static_cast<TraceType>(type)), byType[type].size(),
+                   byType[type].size() / elapsed, failedByType[type]);
+            printLatencies(byType[type]);
+        }
+        printf("%-9s %9zu %9.0f %8zu", "total", all.size(), all.size() / elapsed, failed);
+        printLatencies(all);
+        printf("\nElapsed: %.2f s\n", elapsed);
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return 1;
+    }
+
+    if (options.dataPath.empty()) {
+        LibraryEngine::removeFiles(SCRATCH_FILE);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Library Management System - Record Schema Support
+ * Building blocks for the field list in book.h. The list is an
+ * X-macro: every record layout, codec, validator and formatter is
+ * expanded from it at compile time, so they cannot drift apart.
+ *
+ * Each entry reads X(file, kind, name, label, size, width, low, high):
+ *   file        Hot or Cold (see store.h)
+ *   kind        a FieldKind below
+ *   size        array length of Text and Name fields, 0 for numbers
+ *   width       display column width
+ *   low, high   accepted values, or accepted length for text
+ */
+
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+enum class FieldKind {
+    Key,    // record id, shown zero-padded
+    Int,
+    Real,   // shown with two decimals
+    Text,
+    Name    // text of letters and spaces only
+};
+
+enum class FieldFile {
+    Hot,
+    Cold
+};
+
+// C++ type of a field: 32-bit numbers, fixed char arrays for text
+template <FieldKind Kind, size_t Size>
+struct FieldType {
+    using type = int32_t;
+};
+
+template <size_t Size>
+struct FieldType<FieldKind::Real, Size> {
+    using type = float;
+};
+
+template <size_t Size>
+struct FieldType<FieldKind::Text, Size> {
+    using type = char[Size];
+};
+
+template <size_t Size>
+struct FieldType<FieldKind::Name, Size> {
+    using type = char[Size];
+};
+
+constexpr bool isTextKind(FieldKind kind) {
+    return kind == FieldKind::Text || kind == FieldKind::Name;
+}
+
+// One row of the generated field table
+struct FieldInfo {
+    const char* name;
+    const char* label;
+    FieldKind kind;
+    FieldFile file;
+    size_t size;            // bytes in the record
+    size_t offset;          // in Book
+    size_t fileOffset;      // in HotRecord or ColdRecord
+    int width;
+    double low;
+    double high;
+};
+
+inline bool validText(FieldKind kind, const char* text, size_t length, double low, double high) {
+    if (length < low || length > high) return false;
+    if (kind != FieldKind::Name) return true;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = text[i];
+        if (!isalpha(c) && !isspace(c)) return false;
+    }
+    return true;
+}
+
+/**
+ * Validates one stored field. Numbers are compared in their own type,
+ * so 0.01 is the float 0.01f, and without branches; text is measured
+ * up to the end of its array.
+ */
+template <FieldKind Kind, typename T>
+bool validField(const T& value, double low, double high) {
+    if constexpr (isTextKind(Kind)) {
+        return validText(Kind, value, strnlen(value, sizeof(T)), low, high);
+    } else {
+        return (value >= static_cast<T>(low)) & (value <= static_cast<T>(high));
+    }
+}
+
+#endif
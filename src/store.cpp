@@ -0,0 +1,396 @@
+/**
+ * Library Management System - Record Store Implementation
+ *
+ * Key points:
+ *   - Slot n is at n * sizeof(HotRecord) in books.hot and
+ *     n * sizeof(ColdRecord) in books.cold (16 and 80 bytes today)
+ *   - Appends write the cold record first, so a torn append leaves
+ *     books.hot shorter and open() trims books.cold back to match
+ *   - The intent file (books.hot.swap) is created after both staging
+ *     files are synced; while it exists the swap is rolled forward
+ */
+
+#include "store.h"
+#include "index.h"
+#include "journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Records moved per read when streaming a whole file
+    constexpr size_t STREAM_CHUNK = 4096;
+
+    bool readAt(int fd, void* data, size_t length, uint64_t offset) {
+        char* bytes = static_cast<char*>(data);
+        while (length > 0) {
+            ssize_t got = pread(fd, bytes, length, offset);
+            if (got <= 0) return false;
+            bytes += got;
+            length -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    bool writeAt(int fd, const void* data, size_t length, uint64_t offset) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t written = pwrite(fd, bytes, length, offset);
+            if (written <= 0) return false;
+            bytes += written;
+            length -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    uint64_t fileRecords(int fd, size_t recordSize) {
+        struct stat info;
+        return fstat(fd, &info) == 0 ? info.st_size / recordSize : 0;
+    }
+
+    bool exists(const string& path) {
+        return access(path.c_str(), F_OK) == 0;
+    }
+
+    string stagedPath(const string& path) {
+        return path + ".tmp";
+    }
+
+    string intentPath(const string& hotPath) {
+        return hotPath + ".swap";
+    }
+
+    uint64_t stampChecksum(const LayoutStamp& stamp) {
+        return fnv1a(&stamp, offsetof(LayoutStamp, checksum));
+    }
+
+    // Buffers records into both staging files, cold before hot
+    class StagedWriter {
+    private:
+        int hot;
+        int cold;
+        vector<HotRecord> hotBuffer;
+        vector<ColdRecord> coldBuffer;
+        uint64_t written;
+        bool ok;
+
+        void flush() {
+            ok = ok &&
+                 writeAt(cold, coldBuffer.data(), coldBuffer.size() * sizeof(ColdRecord), written * sizeof(ColdRecord)) &&
+                 writeAt(hot, hotBuffer.data(), hotBuffer.size() * sizeof(HotRecord), written * sizeof(HotRecord));
+            written += hotBuffer.size();
+            hotBuffer.clear();
+            coldBuffer.clear();
+        }
+
+    public:
+        StagedWriter(const string& hotPath, const string& coldPath) :
+            hot(open(stagedPath(hotPath).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+            cold(open(stagedPath(coldPath).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+            written(0),
+            ok(hot >= 0 && cold >= 0) {
+        }
+
+        ~StagedWriter() {
+            if (hot >= 0) close(hot);
+            if (cold >= 0) close(cold);
+        }
+
+        void add(const Book& record) {
+            hotBuffer.push_back(hotPart(record));
+            coldBuffer.push_back(coldPart(record));
+            if (hotBuffer.size() == STREAM_CHUNK) flush();
+        }
+
+        void fail() {
+            ok = false;
+        }
+
+        bool finish() {
+            flush();
+            return ok && fsync(cold) == 0 && fsync(hot) == 0;
+        }
+    };
+
+    bool createIntent(const string& hotPath) {
+        int intent = open(intentPath(hotPath).c_str(), O_WRONLY | O_CREAT, 0644);
+        if (intent < 0) return false;
+        bool ok = fsync(intent) == 0;
+        return close(intent) == 0 && ok;
+    }
+}
+
+RecordStore::RecordStore() :
+    hotFd(-1),
+    coldFd(-1),
+    damagedFiles(false) {
+}
+
+RecordStore::~RecordStore() {
+    close();
+}
+
+bool RecordStore::open(const string& hotFile, const string& coldFile, const string& legacyFile) {
+    close();
+    hotPath = hotFile;
+    coldPath = coldFile;
+    damagedFiles = false;
+
+    if (!finishSwap()) return false;
+    if (!exists(hotPath) && exists(legacyFile) && !migrate(legacyFile)) return false;
+    return openFiles();
+}
+
+bool RecordStore::openFiles() {
+    close();
+    hotFd = ::open(hotPath.c_str(), O_RDWR | O_CREAT, 0644);
+    coldFd = ::open(coldPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (hotFd < 0 || coldFd < 0) return false;
+
+    // Appends write the cold record first, so an interrupted one leaves
+    // books.cold ahead (or a torn hot record); cut that back. Whole hot
+    // records without their cold half are damage, never a crash state.
+    // (ftruncate only when needed: it touches mtime, which would stale the index)
+    struct stat hotInfo, coldInfo;
+    if (fstat(hotFd, &hotInfo) != 0 || fstat(coldFd, &coldInfo) != 0) return false;
+    uint64_t records = hotInfo.st_size / sizeof(HotRecord);
+    if (records > coldInfo.st_size / sizeof(ColdRecord)) {
+        damagedFiles = true;
+        close();
+        return false;
+    }
+    if (static_cast<uint64_t>(hotInfo.st_size) == records * sizeof(HotRecord) &&
+        static_cast<uint64_t>(coldInfo.st_size) == records * sizeof(ColdRecord)) {
+        return true;
+    }
+    return truncate(records);
+}
+
+void RecordStore::close() {
+    if (hotFd >= 0) {
+        ::close(hotFd);
+        hotFd = -1;
+    }
+    if (coldFd >= 0) {
+        ::close(coldFd);
+        coldFd = -1;
+    }
+}
+
+// Rolls an interrupted swap forward, or drops staging files that never got an intent
+bool RecordStore::finishSwap() const {
+    string intent = intentPath(hotPath);
+    if (!exists(intent)) {
+        discardStaged();
+        return true;
+    }
+
+    for (const string& path : { coldPath, hotPath }) {
+        if (exists(stagedPath(path)) && rename(stagedPath(path).c_str(), path.c_str()) != 0) {
+            return false;
+        }
+    }
+    return unlink(intent.c_str()) == 0;
+}
+
+/**
+ * Splits a flat array of Book records into the two files. Runs
+ * through the same staged swap as a delete, so an interrupted
+ * import simply starts again on the next open.
+ */
+bool RecordStore::migrate(const string& legacyPath) const {
+    int legacy = ::open(legacyPath.c_str(), O_RDONLY);
+    if (legacy < 0) return false;
+
+    uint64_t total = fileRecords(legacy, sizeof(Book));
+    vector<Book> chunk(STREAM_CHUNK);
+    bool ok;
+    {
+        StagedWriter writer(hotPath, coldPath);
+        for (uint64_t first = 0; first < total; first += STREAM_CHUNK) {
+            uint64_t chunkSize = min<uint64_t>(STREAM_CHUNK, total - first);
+            if (!readAt(legacy, chunk.data(), chunkSize * sizeof(Book), first * sizeof(Book))) {
+                writer.fail();
+                break;
+            }
+            for (uint64_t i = 0; i < chunkSize; i++) {
+                writer.add(chunk[i]);
+            }
+        }
+        ok = writer.finish();
+    }
+    ::close(legacy);
+
+    if (!ok || !createIntent(hotPath)) {
+        discardStaged();
+        return false;
+    }
+    return finishSwap();
+}
+
+uint64_t RecordStore::count() const {
+    return fileRecords(hotFd, sizeof(HotRecord));
+}
+
+bool RecordStore::read(uint64_t slot, Book& out) const {
+    HotRecord hot;
+    ColdRecord cold;
+    if (!readHot(slot, hot) ||
+        !readAt(coldFd, &cold, sizeof(cold), slot * sizeof(ColdRecord))) {
+        return false;
+    }
+    out = joinParts(hot, cold);
+    return true;
+}
+
+bool RecordStore::write(uint64_t slot, const Book& record) const {
+    ColdRecord cold = coldPart(record);
+    return writeAt(coldFd, &cold, sizeof(cold), slot * sizeof(ColdRecord)) &&
+           writeHot(slot, hotPart(record));
+}
+
+bool RecordStore::readHot(uint64_t slot, HotRecord& out) const {
+    return readAt(hotFd, &out, sizeof(out), slot * sizeof(HotRecord));
+}
+
+bool RecordStore::writeHot(uint64_t slot, const HotRecord& record) const {
+    return writeAt(hotFd, &record, sizeof(record), slot * sizeof(HotRecord));
+}
+
+bool RecordStore::readRange(uint64_t first, uint64_t count, vector<Book>& out) const {
+    vector<HotRecord> hot(count);
+    vector<ColdRecord> cold(count);
+    if (!readAt(hotFd, hot.data(), count * sizeof(HotRecord), first * sizeof(HotRecord)) ||
+        !readAt(coldFd, cold.data(), count * sizeof(ColdRecord), first * sizeof(ColdRecord))) {
+        return false;
+    }
+    out.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        out.push_back(joinParts(hot[i], cold[i]));
+    }
+    return true;
+}
+
+bool RecordStore::readHotRange(uint64_t first, uint64_t count, vector<HotRecord>& out) const {
+    out.resize(count);
+    return readAt(hotFd, out.data(), count * sizeof(HotRecord), first * sizeof(HotRecord));
+}
+
+bool RecordStore::append(uint64_t first, const vector<Book>& records) const {
+    vector<HotRecord> hot;
+    vector<ColdRecord> cold;
+    for (const Book& record : records) {
+        hot.push_back(hotPart(record));
+        cold.push_back(coldPart(record));
+    }
+    return writeAt(coldFd, cold.data(), cold.size() * sizeof(ColdRecord), first * sizeof(ColdRecord)) &&
+           writeAt(hotFd, hot.data(), hot.size() * sizeof(HotRecord), first * sizeof(HotRecord));
+}
+
+bool RecordStore::damaged() const {
+    return damagedFiles;
+}
+
+bool RecordStore::truncate(uint64_t count) const {
+    return ftruncate(hotFd, count * sizeof(HotRecord)) == 0 &&
+           ftruncate(coldFd, count * sizeof(ColdRecord)) == 0;
+}
+
+bool RecordStore::sync() const {
+    return syncFileData(coldFd) == 0 && syncFileData(hotFd) == 0;
+}
+
+void RecordStore::forEachHot(const function<void(uint32_t, const HotRecord&)>& visit) const {
+    uint64_t total = count();
+    vector<HotRecord> chunk;
+    for (uint64_t first = 0; first < total; first += STREAM_CHUNK) {
+        uint64_t chunkSize = min<uint64_t>(STREAM_CHUNK, total - first);
+        if (!readHotRange(first, chunkSize, chunk)) return;
+        for (uint64_t i = 0; i < chunkSize; i++) {
+            visit(static_cast<uint32_t>(first + i), chunk[i]);
+        }
+    }
+}
+
+void RecordStore::forEach(const function<void(uint32_t, const Book&)>& visit) const {
+    uint64_t total = count();
+    vector<Book> chunk;
+    for (uint64_t first = 0; first < total; first += STREAM_CHUNK) {
+        uint64_t chunkSize = min<uint64_t>(STREAM_CHUNK, total - first);
+        if (!readRange(first, chunkSize, chunk)) return;
+        for (uint64_t i = 0; i < chunkSize; i++) {
+            visit(static_cast<uint32_t>(first + i), chunk[i]);
+        }
+    }
+}
+
+string RecordStore::stagedHotFile() const {
+    return stagedPath(hotPath);
+}
+
+string RecordStore::stagedColdFile() const {
+    return stagedPath(coldPath);
+}
+
+bool RecordStore::stage(const function<bool(const Book&)>& keep) const {
+    uint64_t total = count();
+    vector<Book> chunk;
+    StagedWriter writer(hotPath, coldPath);
+    for (uint64_t first = 0; first < total; first += STREAM_CHUNK) {
+        if (!readRange(first, min<uint64_t>(STREAM_CHUNK, total - first), chunk)) {
+            writer.fail();
+            break;
+        }
+        for (const Book& record : chunk) {
+            if (keep(record)) writer.add(record);
+        }
+    }
+    return writer.finish();
+}
+
+bool RecordStore::commitStaged() {
+    if (!createIntent(hotPath)) return false;
+
+    close();
+    bool swapped = finishSwap();
+    return openFiles() && swapped;
+}
+
+void RecordStore::discardStaged() const {
+    unlink(stagedPath(hotPath).c_str());
+    unlink(stagedPath(coldPath).c_str());
+}
+
+vector<int> RecordStore::files() const {
+    return { hotFd, coldFd };
+}
+
+bool readLayout(const string& layoutFile, LayoutStamp& stamp) {
+    int fd = open(layoutFile.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool read = readAt(fd, &stamp, sizeof(stamp), 0);
+    close(fd);
+    return read && stamp.checksum == stampChecksum(stamp);
+}
+
+bool writeLayout(const string& layoutFile) {
+    LayoutStamp stamp = { BOOK_LAYOUT, sizeof(HotRecord), sizeof(ColdRecord), 0 };
+    stamp.checksum = stampChecksum(stamp);
+
+    int fd = open(layoutFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool written = writeAt(fd, &stamp, sizeof(stamp), 0) && syncFileData(fd) == 0;
+    close(fd);
+    return written;
+}
+
+vector<string> storeFiles(const string& hotFile, const string& coldFile) {
+    return { hotFile, coldFile, stagedPath(hotFile), stagedPath(coldFile), intentPath(hotFile) };
+}
@@ -0,0 +1,94 @@
+/**
+ * Library Management System - Record Store
+ * The book table kept as two parallel files joined by slot number:
+ * books.hot holds a 16-byte HotRecord per book, books.cold the title
+ * and author. Circulation and stock-level scans only touch books.hot.
+ *
+ * Whole-table replacements (deletes, restores) are staged next to the
+ * live files and swapped in under a small intent file, so a crash
+ * half-way through the two renames is finished on the next open.
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include "book.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class RecordStore {
+private:
+    int hotFd;
+    int coldFd;
+    string hotPath;
+    string coldPath;
+    bool damagedFiles;
+
+    bool openFiles();
+    bool finishSwap() const;
+    bool migrate(const string& legacyPath) const;
+
+public:
+    RecordStore();
+    ~RecordStore();
+
+    RecordStore(const RecordStore&) = delete;
+    RecordStore& operator=(const RecordStore&) = delete;
+
+    // Creates the files when missing, importing a flat legacy Book
+    // file (books.dat) the first time; the legacy file is left as is
+    bool open(const string& hotFile, const string& coldFile, const string& legacyFile);
+    void close();
+    // True when open() refused books.hot records that books.cold lacks
+    bool damaged() const;
+
+    uint64_t count() const;
+    bool read(uint64_t slot, Book& out) const;
+    bool write(uint64_t slot, const Book& record) const;
+    bool readHot(uint64_t slot, HotRecord& out) const;
+    bool writeHot(uint64_t slot, const HotRecord& record) const;
+    // Reads count consecutive books starting at first
+    bool readRange(uint64_t first, uint64_t count, vector<Book>& out) const;
+    bool readHotRange(uint64_t first, uint64_t count, vector<HotRecord>& out) const;
+    bool append(uint64_t first, const vector<Book>& records) const;
+    bool truncate(uint64_t count) const;
+    bool sync() const;
+
+    // Streams in slot order; forEachHot never reads books.cold
+    void forEachHot(const function<void(uint32_t, const HotRecord&)>& visit) const;
+    void forEach(const function<void(uint32_t, const Book&)>& visit) const;
+
+    // Staged replacement: write the staging files, then swap them in
+    string stagedHotFile() const;
+    string stagedColdFile() const;
+    bool stage(const function<bool(const Book&)>& keep) const;
+    bool commitStaged();
+    void discardStaged() const;
+
+    // Column descriptors for the backup chain: hot first, then cold
+    vector<int> files() const;
+};
+
+// books.layout: the BOOK_LAYOUT the record files were written with
+struct LayoutStamp {
+    uint64_t layout;
+    uint32_t hotSize;       // sizeof(HotRecord) at the time
+    uint32_t coldSize;      // sizeof(ColdRecord) at the time
+    uint64_t checksum;
+};
+
+// False when the stamp is missing or torn
+bool readLayout(const string& layoutFile, LayoutStamp& stamp);
+// Stamps the current layout
+bool writeLayout(const string& layoutFile);
+
+// Every file a store over these columns can leave behind, staging and
+// intent files included
+vector<string> storeFiles(const string& hotFile, const string& coldFile);
+
+#endif
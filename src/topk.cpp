@@ -0,0 +1,61 @@
+/**
+ * Library Management System - Top-K Ranking Implementation
+ *
+ * Key points:
+ *   - The heap is ordered so its front is the entry that would be
+ *     dropped next; a candidate only has to beat that one
+ *   - Ties are broken by id, so partitioned and single-threaded runs
+ *     return exactly the same records
+ */
+
+#include "topk.h"
+
+#include <algorithm>
+
+double rankValue(RankKey key, const HotRecord& record) {
+    switch (key) {
+        case RankKey::Price: return record.price;
+        case RankKey::Quantity: return record.quantity;
+        case RankKey::Value: return static_cast<double>(record.price) * record.quantity;
+    }
+    return 0.0;
+}
+
+TopKHeap::TopKHeap(size_t limit, bool highest) :
+    limit(limit),
+    highest(highest) {
+    heap.reserve(limit);
+}
+
+bool TopKHeap::ranksBefore(const RankedSlot& a, const RankedSlot& b) const {
+    if (a.key != b.key) return highest ? a.key > b.key : a.key < b.key;
+    return a.id < b.id;
+}
+
+void TopKHeap::offer(const RankedSlot& candidate) {
+    if (limit == 0) return;
+
+    // With ranksBefore as "less", the heap front is the worst entry
+    auto order = [this](const RankedSlot& a, const RankedSlot& b) { return ranksBefore(a, b); };
+    if (heap.size() < limit) {
+        heap.push_back(candidate);
+        push_heap(heap.begin(), heap.end(), order);
+    } else if (ranksBefore(candidate, heap.front())) {
+        pop_heap(heap.begin(), heap.end(), order);
+        heap.back() = candidate;
+        push_heap(heap.begin(), heap.end(), order);
+    }
+}
+
+void TopKHeap::merge(const TopKHeap& other) {
+    for (const RankedSlot& entry : other.heap) {
+        offer(entry);
+    }
+}
+
+vector<RankedSlot> TopKHeap::sorted() const {
+    vector<RankedSlot> result = heap;
+    sort(result.begin(), result.end(),
+         [this](const RankedSlot& a, const RankedSlot& b) { return ranksBefore(a, b); });
+    return result;
+}
@@ -0,0 +1,57 @@
+/**
+ * Library Management System - Top-K Ranking
+ * Keeps the K best records of a stream in O(K) memory, so reports
+ * such as "20 lowest-stock titles" never sort the whole catalog.
+ *
+ * Every rank key is a field of the hot record (book.h), so a ranking
+ * pass reads books.hot only. Each worker fills its own TopKHeap over a
+ * slice of the slots; the partial heaps are merged at the end.
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "book.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+enum class RankKey {
+    Price,
+    Quantity,
+    Value       // price * quantity, the stock value of a title
+};
+
+struct RankedSlot {
+    double key;
+    int32_t id;
+    uint32_t slot;
+};
+
+double rankValue(RankKey key, const HotRecord& record);
+
+class TopKHeap {
+private:
+    size_t limit;
+    bool highest;               // rank descending rather than ascending
+    vector<RankedSlot> heap;    // worst kept entry on top
+
+    // Strict ranking order; equal keys go to the lower id
+    bool ranksBefore(const RankedSlot& a, const RankedSlot& b) const;
+
+public:
+    TopKHeap(size_t limit, bool highest);
+
+    // O(1) when the candidate does not beat the worst kept entry,
+    // O(log K) when it replaces it
+    void offer(const RankedSlot& candidate);
+    void merge(const TopKHeap& other);
+
+    // Kept entries, best first
+    vector<RankedSlot> sorted() const;
+};
+
+#endif
@@ -0,0 +1,262 @@
+/**
+ * Library Management System - Workload Trace Implementation
+ *
+ * Key points:
+ *   - Text fields have tabs and line breaks replaced by spaces when
+ *     written, so every operation stays one line
+ *   - Prices are written with two decimals, like every other output
+ *   - The writer flushes each line, so a crashed session still
+ *     leaves a usable trace behind
+ */
+
+#include "trace.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+    const char* const TRACE_HEADER = "# library trace v1";
+
+    const char* const TYPE_NAMES[TRACE_TYPES] = {
+        "add", "search", "find", "update", "delete", "display", "checkout", "return"
+    };
+
+    string traceText(const char* text, size_t maxLen) {
+        string value(text, strnlen(text, maxLen));
+        for (char& c : value) {
+            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        }
+        return value;
+    }
+
+    string traceText(const string& text) {
+        return traceText(text.c_str(), text.size());
+    }
+
+    string tracePrice(float price) {
+        char number[32];
+        snprintf(number, sizeof(number), "%.2f", price);
+        return number;
+    }
+
+    vector<string> splitFields(const string& line) {
+        vector<string> fields;
+        size_t begin = 0;
+        while (true) {
+            size_t tab = line.find('\t', begin);
+            fields.push_back(line.substr(begin, tab == string::npos ? string::npos : tab - begin));
+            if (tab == string::npos) return fields;
+            begin = tab + 1;
+        }
+    }
+
+    bool parseNumber(const string& text, long long& out) {
+        if (text.empty()) return false;
+        char* end;
+        errno = 0;
+        out = strtoll(text.c_str(), &end, 10);
+        return errno == 0 && *end == '\0';
+    }
+
+    bool parseInt(const string& text, int& out) {
+        long long value;
+        if (!parseNumber(text, value) || value < INT32_MIN || value > INT32_MAX) return false;
+        out = static_cast<int>(value);
+        return true;
+    }
+
+    bool parsePrice(const string& text, float& out) {
+        if (text.empty()) return false;
+        char* end;
+        out = strtof(text.c_str(), &end);
+        return *end == '\0';
+    }
+}
+
+TraceOp traceOp(TraceType type, int id) {
+    TraceOp op;
+    op.type = type;
+    op.id = id;
+    return op;
+}
+
+const char* traceTypeName(TraceType type) {
+    return TYPE_NAMES[static_cast<size_t>(type)];
+}
+
+bool parseTraceType(const string& name, TraceType& out) {
+    for (size_t i = 0; i < TRACE_TYPES; i++) {
+        if (name == TYPE_NAMES[i]) {
+            out = static_cast<TraceType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+string formatTraceOp(const TraceOp& op) {
+    string line = to_string(op.atUs) + '\t' + traceTypeName(op.type);
+    switch (op.type) {
+        case TraceType::Add:
+            line += '\t' + to_string(op.record.id) +
+                    '\t' + traceText(op.record.title, MAX_TITLE_LENGTH) +
+                    '\t' + traceText(op.record.author, MAX_AUTHOR_LENGTH) +
+                    '\t' + tracePrice(op.record.price) +
+                    '\t' + to_string(op.record.quantity);
+            break;
+        case TraceType::Update:
+            line += '\t' + to_string(op.id) +
+                    '\t' + (op.patch.title ? traceText(*op.patch.title) : string()) +
+                    '\t' + (op.patch.author ? traceText(*op.patch.author) : string()) +
+                    '\t' + (op.patch.price ? tracePrice(*op.patch.price) : string()) +
+                    '\t' + (op.patch.quantity ? to_string(*op.patch.quantity) : string());
+            break;
+        case TraceType::Find:
+            line += '\t' + traceText(op.query);
+            break;
+        default:
+            line += '\t' + to_string(op.id);
+            break;
+    }
+    return line;
+}
+
+bool parseTraceOp(const string& line, TraceOp& out) {
+    vector<string> fields = splitFields(line);
+    long long atUs;
+    if (fields.size() < 3 || !parseNumber(fields[0], atUs) || !parseTraceType(fields[1], out.type)) {
+        return false;
+    }
+    out.atUs = atUs;
+
+    switch (out.type) {
+        case TraceType::Add:
+            out.record = {};
+            if (fields.size() != 7 ||
+                !parseInt(fields[2], out.record.id) ||
+                !parsePrice(fields[5], out.record.price) ||
+                !parseInt(fields[6], out.record.quantity)) {
+                return false;
+            }
+            safeStrCopy(out.record.title, fields[3]);
+            safeStrCopy(out.record.author, fields[4]);
+            out.id = out.record.id;
+            return true;
+
+        case TraceType::Update: {
+            if (fields.size() != 7 || !parseInt(fields[2], out.id)) return false;
+            out.patch = BookPatch();
+            float price;
+            int quantity;
+            if (!fields[3].empty()) out.patch.title = fields[3];
+            if (!fields[4].empty()) out.patch.author = fields[4];
+            if (!fields[5].empty()) {
+                if (!parsePrice(fields[5], price)) return false;
+                out.patch.price = price;
+            }
+            if (!fields[6].empty()) {
+                if (!parseInt(fields[6], quantity)) return false;
+                out.patch.quantity = quantity;
+            }
+            return true;
+        }
+
+        case TraceType::Find:
+            out.query = fields[2];
+            return fields.size() == 3 && !out.query.empty();
+
+        default:
+            return fields.size() == 3 && parseInt(fields[2], out.id);
+    }
+}
+
+bool readTrace(const string& path, vector<TraceOp>& out, string& error) {
+    ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    string line;
+    for (size_t number = 1; getline(file, line); number++) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        TraceOp op;
+        if (!parseTraceOp(line, op)) {
+            error = path + ":" + to_string(number) + ": malformed operation";
+            return false;
+        }
+        out.push_back(move(op));
+    }
+    return true;
+}
+
+bool runTraceOp(LibraryEngine& engine, const TraceOp& op) {
+    Book book;
+    switch (op.type) {
+        case TraceType::Add:
+            return engine.put(op.record);
+        case TraceType::Search:
+            return engine.get(op.id, book);
+        case TraceType::Find:
+            engine.fuzzySearch(op.query, FUZZY_RESULTS);
+            return true;
+        case TraceType::Update:
+            return engine.update(op.id, op.patch);
+        case TraceType::Delete:
+            return engine.erase(op.id);
+        case TraceType::Checkout:
+            return engine.checkout(op.id) == CirculationStatus::Ok;
+        case TraceType::Return:
+            return engine.returnBook(op.id) == CirculationStatus::Ok;
+        case TraceType::Display: {
+            // Same page read as the menu's page view
+            vector<Book> page;
+            return engine.readRange(static_cast<size_t>(max(op.id, 1) - 1) * RECORDS_PER_PAGE,
+                                    RECORDS_PER_PAGE, page) > 0;
+        }
+    }
+    return false;
+}
+
+TraceWriter::TraceWriter() :
+    file(nullptr) {
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const string& path) {
+    close();
+    file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    start = chrono::steady_clock::now();
+    fprintf(file, "%s\n", TRACE_HEADER);
+    return fflush(file) == 0;
+}
+
+void TraceWriter::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool TraceWriter::isOpen() const {
+    return file != nullptr;
+}
+
+void TraceWriter::record(TraceOp op) {
+    if (!file) return;
+    op.atUs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    write(op);
+}
+
+void TraceWriter::write(const TraceOp& op) {
+    lock_guard<mutex> guard(lock);
+    if (!file) return;
+    fprintf(file, "%s\n", formatTraceOp(op).c_str());
+    fflush(file);
+}
@@ -0,0 +1,91 @@
+/**
+ * Library Management System - Workload Traces
+ * A recorded sequence of engine operations, one per line, so a menu
+ * session can be replayed and a synthetic load written down exactly.
+ *
+ * Lines are tab-separated, starting with the time in microseconds
+ * since the trace began; empty update fields keep the current value:
+ *   120     add       11  <title>  <author>  <price>  <quantity>
+ *   480     search    11
+ *   900     find      <title or author text>
+ *   1500    update    11  <title>  <author>  <price>  <quantity>
+ *   2100    delete    11
+ *   2600    display   3            (page number)
+ *   3000    checkout  11
+ *   3400    return    11
+ * Lines starting with '#' are comments.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "engine.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum class TraceType {
+    Add,
+    Search,
+    Find,
+    Update,
+    Delete,
+    Display,
+    Checkout,
+    Return
+};
+
+constexpr size_t TRACE_TYPES = 8;
+
+struct TraceOp {
+    int64_t atUs = 0;
+    TraceType type = TraceType::Search;
+    int id = 0;             // book id, or the page for Display
+    Book record = {};       // Add
+    BookPatch patch;        // Update
+    string query;           // Find
+};
+
+TraceOp traceOp(TraceType type, int id);
+const char* traceTypeName(TraceType type);
+bool parseTraceType(const string& name, TraceType& out);
+
+string formatTraceOp(const TraceOp& op);
+bool parseTraceOp(const string& line, TraceOp& out);
+// Stops at the first malformed line and names it in error
+bool readTrace(const string& path, vector<TraceOp>& out, string& error);
+
+// Runs op against the engine the way the menu does; false when the
+// engine reports a failure or the book is missing
+bool runTraceOp(LibraryEngine& engine, const TraceOp& op);
+
+// Appends operations to a trace file, timed from open(); safe across threads
+class TraceWriter {
+private:
+    FILE* file;
+    chrono::steady_clock::time_point start;
+    mutex lock;
+
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool open(const string& path);
+    void close();
+    bool isOpen() const;
+
+    // Stamps op with the current time; does nothing unless open
+    void record(TraceOp op);
+    // Writes op with its own timestamp, for generated workloads
+    void write(const TraceOp& op);
+};
+
+#endif